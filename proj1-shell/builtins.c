@@ -1,16 +1,36 @@
+#define _GNU_SOURCE   /* memrchr */
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/resource.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include "utils.h"
+#include "trace.h"
+#include "history.h"
+#include "shell.h"
+#include "builtins.h"
+#ifdef __SSE2__
+#include <emmintrin.h>  /* newline counting in `wc` */
+#endif
 
+#define SH_STREAM_BUFFSIZE (256 * 1024)   /* chunk size when the input can't be mmap'd (pipes, ttys) */
 
-char *builtin_func_names[] = {"cd", "echo", "etime", "exit", "io"};
+
+char *builtin_func_names[] = {"cat", "cd", "echo", "etime", "exec", "exit", "head", "history", "io", "limit", "set",
+                              "source", "stats", "tail", "wc"};
+
+/* the builtins that only read files and write stdout, safe to run in a forked child without exec */
+static char *stream_builtin_names[] = {"cat", "head", "tail", "wc"};
 
 /** args[0] is always 'cd' and args[1] is the path
  * if there is more than one path, signal an error
@@ -30,7 +50,16 @@ int sh_cd(char ** args)
         setenv("PWD", cwd, 1);
     else
         perror("getcwd() error");
-    return 1;
+    return ret < 0;
+}
+
+
+/* a waited child's status as the shell reports it, 128 + signal if it was killed */
+static int _child_status(int status)
+{
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
 }
 
 
@@ -41,6 +70,7 @@ int sh_etime(char **args)
     int i = 0;
     char ** args_cpy = strstr_copy(args + 1);
     struct timeval start, end, difference;
+    int status;
 
     gettimeofday(&start, NULL);
 
@@ -52,11 +82,11 @@ int sh_etime(char **args)
     else if (pid == 0) {
         execv(args_cpy[0], args_cpy);
         perror("sh: etime exec failure");
-        return 1;
+        _exit(127);
     }
     else {
         /* block waiting for child to execute */
-        waitpid(pid, 0, 0);
+        waitpid(pid, &status, 0);
         gettimeofday(&end, NULL);
     }
 
@@ -72,7 +102,7 @@ int sh_etime(char **args)
 
     _free2d(args_cpy);
     printf("Elapsed time: %f\n", ((double)difference.tv_sec + ((double)difference.tv_usec/1000000.0)));
-    return 1;
+    return _child_status(status);
 }
 
 
@@ -82,7 +112,7 @@ int sh_etime(char **args)
 int sh_exit(char **args)
 {
     printf("Exiting Shell....\n");
-    return 0;
+    return SH_BUILTIN_EXIT;
 }
 
 
@@ -95,7 +125,7 @@ int sh_echo(char **args)
         i++;
     }
     printf("\n");
-    return 1;
+    return 0;
 }
 
 
@@ -103,7 +133,7 @@ int sh_io(char **args)
 {
 	char * filename;
     pid_t pid = fork();
-    /* ret will be 0 or 1, indicating whether we want the shell to keep running or not */
+    /* the exit status, 1 if the command couldn't be run or its io read */
     int ret;
     /* create copy of args without the 'io' command */
     char **args_cpy = strstr_copy(args + 1);
@@ -115,7 +145,7 @@ int sh_io(char **args)
     else if (pid == 0) {
        execv(args_cpy[0], args_cpy);
        perror("sh: io exec failure");
-       ret = 1;
+       _exit(127);
     }
     else{
         /* need to get data in /proc/pid/io */
@@ -146,20 +176,754 @@ int sh_io(char **args)
     	}
     	printf("\n");
         waitpid(pid, NULL, 0);
-        ret = 1;
+        ret = 0;
     }
     _free2d(args_cpy);
     return ret;
 }
 
 
+/**
+ * given input ["exec", "cmd", "arg1", ..., NULL], replace the shell with <cmd>
+ * command_group_execute has already applied any redirections to fds 0 and 1, so they carry over without a fork
+ */
+int sh_exec(char **args)
+{
+    if (!args[1])
+        return 0;
+    fflush(stdout);
+    /* atexit handlers don't run across exec, so write the trace out now */
+    if (trace_is_enabled())
+        trace_dump();
+    execv(args[1], args + 1);
+    perror("sh: exec failure");
+    return errno == ENOENT ? 127 : 126;
+}
+
+
+/* given input ["source", "file", NULL], run each line of <file> in this shell */
+int sh_source(char **args)
+{
+    int status;
+    if (!args[1]) {
+        fprintf(stderr, "sh: source: usage: source file\n");
+        return 1;
+    }
+    status = sh_source_file(args[1]);
+    /* a parse error on the last line counts as 1, as for `set -e` */
+    return status < 0 ? 1 : status;
+}
+
+
+/**
+ * given input ["set", "-o"|"+o", "option", NULL], turn a shell option on (-o) or off (+o), no args lists them
+ * `set -e` / `set +e` are shorthand for `set -o errexit` / `set +o errexit`
+ */
+int sh_set(char **args)
+{
+    bool enable;
+    char *option;
+    if (!args[1]) {
+        printf("errexit\t%s\n", sh_opt_errexit ? "on" : "off");
+        printf("trace\t%s\n", trace_is_enabled() ? "on" : "off");
+        return 0;
+    }
+    if (strcmp(args[1], "-e") == 0 || strcmp(args[1], "+e") == 0)
+        option = "errexit";
+    else if ((strcmp(args[1], "-o") == 0 || strcmp(args[1], "+o") == 0) && args[2])
+        option = args[2];
+    else {
+        fprintf(stderr, "sh: set: usage: set [-e|+e] [-o|+o option]\n");
+        return 1;
+    }
+    enable = args[1][0] == '-';
+    if (strcmp(option, "trace") == 0)
+        trace_set_enabled(enable);
+    else if (strcmp(option, "errexit") == 0)
+        sh_opt_errexit = enable;
+    else {
+        fprintf(stderr, "sh: set: %s: invalid option name\n", option);
+        return 1;
+    }
+    return 0;
+}
+
+
+/* given input ["history", "[N]", NULL] print the last N (or all) entries, ["history", "-s", "pattern", "[N]", NULL] searches */
+int sh_history(char **args)
+{
+    long limit;
+    if (args[1] && strcmp(args[1], "-s") == 0) {
+        if (!args[2]) {
+            fprintf(stderr, "sh: history: usage: history -s pattern [N]\n");
+            return 1;
+        }
+        /* most recent matches first, 20 unless told otherwise */
+        limit = args[3] ? atol(args[3]) : 20;
+        history_search(args[2], limit > 0 ? limit : 20);
+    }
+    else
+        history_print(args[1] ? atol(args[1]) : 0);
+    return 0;
+}
+
+
+/* print the per-phase latency histograms collected while tracing */
+int sh_stats(char **args)
+{
+    if (!trace_is_enabled())
+        printf("tracing is off, enable with `set -o trace` or SH_TRACE=1\n");
+    trace_print_stats();
+    return 0;
+}
+
+
+/**
+ ************************************************************************************
+ ******************************** Resource Limits ***********************************
+ ************************************************************************************
+ */
+
+#define SH_CGROUP_PERIOD_US 100000   /* cpu.max period, the quota is a percentage of this */
+
+/* the limits given to `limit`, -1 when not set */
+typedef struct {
+    long cpu_sec;        /* RLIMIT_CPU */
+    long as_bytes;       /* RLIMIT_AS */
+    long nofile;         /* RLIMIT_NOFILE */
+    long mem_bytes;      /* cgroup memory.max */
+    long cpu_pct;        /* cgroup cpu.max, percent of one cpu */
+} ResourceLimits;
+
+
+/* parse "512", "64K", "512M", "2G" into bytes, -1 on garbage */
+static long _parse_size(const char *str)
+{
+    char *end;
+    long val = strtol(str, &end, 10);
+    if (end == str || val < 0)
+        return -1;
+    switch (toupper(*end)) {
+        case 'G': val *= 1024;  /* fall through */
+        case 'M': val *= 1024;  /* fall through */
+        case 'K': val *= 1024; end++; break;
+        case '\0': break;
+        default: return -1;
+    }
+    return *end ? -1 : val;
+}
+
+
+/* parse the key=value args after `limit`, returns the index of the command or -1 on a bad option */
+static int _parse_limits(char **args, ResourceLimits *limits)
+{
+    int i;
+    char *val;
+    long *field;
+    limits->cpu_sec = limits->as_bytes = limits->nofile = limits->mem_bytes = limits->cpu_pct = -1;
+    for (i = 1; args[i] && (val = strchr(args[i], '=')) != NULL; i++) {
+        val++;
+        if (strncmp(args[i], "cpu=", 4) == 0)
+            field = &limits->cpu_sec;
+        else if (strncmp(args[i], "as=", 3) == 0)
+            field = &limits->as_bytes;
+        else if (strncmp(args[i], "nofile=", 7) == 0)
+            field = &limits->nofile;
+        else if (strncmp(args[i], "mem=", 4) == 0)
+            field = &limits->mem_bytes;
+        else if (strncmp(args[i], "cpumax=", 7) == 0)
+            field = &limits->cpu_pct;
+        else {
+            fprintf(stderr, "sh: limit: unknown limit %s\n", args[i]);
+            return -1;
+        }
+        /* only the byte sized limits take a K/M/G suffix */
+        *field = (field == &limits->as_bytes || field == &limits->mem_bytes) ? _parse_size(val) : atol(val);
+        if (*field <= 0) {
+            fprintf(stderr, "sh: limit: bad value in %s\n", args[i]);
+            return -1;
+        }
+    }
+    if (!args[i]) {
+        fprintf(stderr, "sh: limit: usage: limit [cpu=SEC] [as=SIZE] [nofile=N] [mem=SIZE] [cpumax=PCT] cmd ...\n");
+        return -1;
+    }
+    return i;
+}
+
+
+static int _write_file(const char *path, const char *str)
+{
+    int ret, fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return -1;
+    ret = write(fd, str, strlen(str)) == (ssize_t) strlen(str) ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+
+/* read a single number from `path` (memory.peak), or the value of `key` if it is a flat keyed file (cpu.stat) */
+static long long _read_cgroup_value(const char *path, const char *key)
+{
+    char line[256], name[64];
+    long long val = -1, tmp;
+    FILE *in = fopen(path, "r");
+    if (!in)
+        return -1;
+    while (fgets(line, sizeof(line), in)) {
+        if (!key && sscanf(line, "%lld", &tmp) == 1)
+            val = tmp;
+        else if (key && sscanf(line, "%63s %lld", name, &tmp) == 2 && strcmp(name, key) == 0)
+            val = tmp;
+    }
+    fclose(in);
+    return val;
+}
+
+
+/**
+ * create a cgroup v2 for the limited command under the shell's own cgroup, and apply memory.max and cpu.max
+ * returns the malloc'd path of the new cgroup, or NULL if cgroup v2 isn't mounted or writable (rlimits still apply)
+ */
+static char *_cgroup_create(ResourceLimits *limits)
+{
+    static int counter;
+    const char *mounts[] = {"/sys/fs/cgroup", "/sys/fs/cgroup/unified"};
+    char line[4096], path[4096], *own = NULL, *mount = NULL;
+    FILE *in;
+
+    for (int i = 0; i < 2 && !mount; i++) {
+        snprintf(path, sizeof(path), "%s/cgroup.controllers", mounts[i]);
+        if (access(path, F_OK) == 0)
+            mount = (char *) mounts[i];
+    }
+    if (!mount || !(in = fopen("/proc/self/cgroup", "r")))
+        return NULL;
+    /* the v2 hierarchy is the "0::<path>" line */
+    while (fgets(line, sizeof(line), in))
+        if (strncmp(line, "0::", 3) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            own = line + 3;
+            break;
+        }
+    fclose(in);
+    if (!own)
+        return NULL;
+
+    snprintf(path, sizeof(path), "%s%s/sh-limit.%d.%d", mount, strcmp(own, "/") == 0 ? "" : own, getpid(), counter++);
+    if (mkdir(path, 0755) < 0)
+        return NULL;
+    char *cgroup = strdup(path), *parent = strdup(path);
+    *strrchr(parent, '/') = '\0';
+
+    /* controllers have to be enabled in the parent first, which fails if it has processes of its own (not root) */
+    if (limits->mem_bytes > 0 || limits->cpu_pct > 0) {
+        snprintf(path, sizeof(path), "%s/cgroup.subtree_control", parent);
+        _write_file(path, "+memory +cpu");
+    }
+    if (limits->mem_bytes > 0) {
+        snprintf(path, sizeof(path), "%s/memory.max", cgroup);
+        snprintf(line, sizeof(line), "%ld", limits->mem_bytes);
+        if (_write_file(path, line) < 0)
+            fprintf(stderr, "sh: limit: memory controller unavailable, mem= not applied\n");
+    }
+    if (limits->cpu_pct > 0) {
+        snprintf(path, sizeof(path), "%s/cpu.max", cgroup);
+        snprintf(line, sizeof(line), "%ld %d", limits->cpu_pct * SH_CGROUP_PERIOD_US / 100, SH_CGROUP_PERIOD_US);
+        if (_write_file(path, line) < 0)
+            fprintf(stderr, "sh: limit: cpu controller unavailable, cpumax= not applied\n");
+    }
+    free(parent);
+    return cgroup;
+}
+
+
+/* apply the rlimits to the calling (child) process, both soft and hard so the command can't raise them */
+static void _apply_rlimits(ResourceLimits *limits)
+{
+    struct rlimit rl;
+    int resources[] = {RLIMIT_CPU, RLIMIT_AS, RLIMIT_NOFILE};
+    long values[] = {limits->cpu_sec, limits->as_bytes, limits->nofile};
+    for (int i = 0; i < 3; i++) {
+        if (values[i] <= 0)
+            continue;
+        rl.rlim_cur = rl.rlim_max = values[i];
+        if (setrlimit(resources[i], &rl) < 0)
+            perror("sh: limit: setrlimit");
+    }
+}
+
+
+/**
+ * given input ["limit", "key=value", ..., "cmd", "arg1", ..., NULL], execute <cmd> under the limits, then print
+ * its peak memory and throttled cpu time
+ */
+int sh_limit(char **args)
+{
+    ResourceLimits limits;
+    struct rusage usage;
+    char path[4096], *cgroup;
+    long long peak = -1, throttled_us = -1, nr_throttled = -1;
+    int status, i = _parse_limits(args, &limits);
+    pid_t pid;
+
+    if (i < 0)
+        return 1;
+    cgroup = _cgroup_create(&limits);
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == -1) {
+        perror("sh: limit failed to fork");
+        free(cgroup);
+        return 1;
+    }
+    else if (pid == 0) {
+        /* join the cgroup before exec, so everything the command forks is accounted and limited too */
+        if (cgroup) {
+            snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup);
+            if (_write_file(path, "0") < 0)
+                fprintf(stderr, "sh: limit: failed to join %s\n", cgroup);
+        }
+        _apply_rlimits(&limits);
+        execv(args[i], args + i);
+        perror("sh: limit exec failure");
+        _exit(127);
+    }
+
+    wait4(pid, &status, 0, &usage);
+    if (cgroup) {
+        snprintf(path, sizeof(path), "%s/memory.peak", cgroup);
+        peak = _read_cgroup_value(path, NULL);
+        snprintf(path, sizeof(path), "%s/cpu.stat", cgroup);
+        throttled_us = _read_cgroup_value(path, "throttled_usec");
+        nr_throttled = _read_cgroup_value(path, "nr_throttled");
+        rmdir(cgroup);
+        free(cgroup);
+    }
+
+    if (WIFSIGNALED(status))
+        printf("limit: killed by signal %d (%s)\n", WTERMSIG(status), strsignal(WTERMSIG(status)));
+    else
+        printf("limit: exit status %d\n", WEXITSTATUS(status));
+    /* without the memory controller fall back to the max rss of the child */
+    if (peak >= 0)
+        printf("limit: peak memory %lld KB (cgroup)\n", peak / 1024);
+    else
+        printf("limit: peak memory %ld KB (max rss)\n", usage.ru_maxrss);
+    printf("limit: cpu time %.3fs user, %.3fs sys\n",
+           usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6, usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6);
+    if (throttled_us >= 0)
+        printf("limit: cpu throttled %.3fs over %lld periods\n", throttled_us / 1e6, nr_throttled);
+    fflush(stdout);
+    return _child_status(status);
+}
+
+
+/**
+ ************************************************************************************
+ ******************************** Stream Builtins ***********************************
+ ************************************************************************************
+ */
+
+
+/* write all of `buf` to `fd`, retrying on short writes */
+static int _write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+
+/* open `path` for reading, "-" or NULL means stdin, returns -1 (after printing) on failure */
+static int _open_input(char *cmd, char *path)
+{
+    int fd;
+    if (!path || strcmp(path, "-") == 0)
+        return STDIN_FILENO;
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        fprintf(stderr, "sh: %s: %s: %s\n", cmd, path, strerror(errno));
+    return fd;
+}
+
+
+static void _close_input(int fd)
+{
+    if (fd != STDIN_FILENO)
+        close(fd);
+}
+
+
+/**
+ * map the whole of a regular file read-only
+ * returns NULL when `fd` isn't a non-empty regular file, the caller then falls back to read()
+ */
+static char *_map_file(int fd, size_t *len)
+{
+    struct stat st;
+    char *map;
+    *len = 0;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return NULL;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    *len = st.st_size;
+    return map;
+}
+
+
+/* slurp a non-mappable input (pipe, tty) into a growing buffer, used by `tail`, NULL on a read or allocation error */
+static char *_read_all(int fd, size_t *len)
+{
+    size_t cap = SH_STREAM_BUFFSIZE;
+    char *buf = malloc(cap), *tmp;
+    ssize_t n;
+    *len = 0;
+    while (buf) {
+        if (*len == cap) {
+            tmp = realloc(buf, cap *= 2);
+            if (!tmp)
+                break;
+            buf = tmp;
+        }
+        n = read(fd, buf + *len, cap - *len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0)
+            return buf;
+        if (n < 0)
+            break;
+        *len += n;
+    }
+    free(buf);
+    return NULL;
+}
+
+
+/* parse the `-n N` / `-c N` flags shared by head and tail, returns index of the first file arg or -1 (after printing) */
+static int _parse_count_flags(char **args, long *count, int *bytes)
+{
+    int i = 1;
+    *count = 10;
+    *bytes = 0;
+    while (args[i] && (strcmp(args[i], "-n") == 0 || strcmp(args[i], "-c") == 0)) {
+        if (!args[i + 1] || !isdigit(args[i + 1][0])) {
+            fprintf(stderr, "sh: %s: %s expects a number\n", args[0], args[i]);
+            return -1;
+        }
+        *bytes = args[i][1] == 'c';
+        *count = atol(args[i + 1]);
+        i += 2;
+    }
+    if (args[i] && args[i][0] == '-' && args[i][1]) {
+        fprintf(stderr, "sh: %s: usage: %s [-n N|-c N] [file]\n", args[0], args[0]);
+        return -1;
+    }
+    return i;
+}
+
+
+/* copy everything from `in` to `out`, sendfile when `in` is a regular file so the data never hits userspace */
+static int _copy_fd(int in, int out)
+{
+    struct stat st;
+    off_t off = 0;
+    ssize_t n;
+    char *buf;
+
+    if (fstat(in, &st) == 0 && S_ISREG(st.st_mode)) {
+        /* file to file can be done (or reflinked) by the filesystem itself, anything else goes through sendfile */
+        while (off < st.st_size && (n = copy_file_range(in, &off, out, NULL, st.st_size - off, 0)) > 0)
+            ;
+        while (off < st.st_size && (n = sendfile(out, in, &off, st.st_size - off)) > 0)
+            ;
+        if (off >= st.st_size)
+            return 0;
+        /* `out` supports neither, finish the rest with read/write */
+        lseek(in, off, SEEK_SET);
+    }
+    buf = malloc(SH_STREAM_BUFFSIZE);
+    if (!buf)
+        return -1;
+    while ((n = read(in, buf, SH_STREAM_BUFFSIZE)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (_write_all(out, buf, n) < 0)
+            break;
+    }
+    free(buf);
+    return n == 0 ? 0 : -1;
+}
+
+
+/* given input ["cat", "file1", ..., NULL], concatenate the files (or stdin) to stdout */
+int sh_cat(char **args)
+{
+    int fd, i = 1, status = 0;
+    fflush(stdout);
+    do {
+        if ((fd = _open_input(args[0], args[i])) < 0) {
+            status = 1;
+            continue;
+        }
+        if (_copy_fd(fd, STDOUT_FILENO) < 0) {
+            perror("sh: cat");
+            status = 1;
+        }
+        _close_input(fd);
+    } while (args[i] && args[++i]);
+    return status;
+}
+
+
+/* count the newlines, words, and bytes in `buf`, `in_word` carries word state across chunks */
+static void _wc_chunk(const char *buf, size_t len, int want_words, long *lines, long *words, int *in_word)
+{
+    const char *p, *end = buf + len;
+    size_t i = 0;
+#ifdef __SSE2__
+    /* compare 16 bytes at a time, accumulating per-byte match counts for at most 255 rounds before summing (psadbw) */
+    const __m128i newlines = _mm_set1_epi8('\n');
+    __m128i acc, sums;
+    int rounds;
+    while (i + 16 <= len) {
+        acc = _mm_setzero_si128();
+        for (rounds = 0; rounds < 255 && i + 16 <= len; rounds++, i += 16)
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (buf + i)), newlines));
+        sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+        *lines += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+    }
+#endif
+    for (; i < len; i++)
+        *lines += buf[i] == '\n';
+    if (!want_words)
+        return;
+    for (p = buf; p < end; p++) {
+        if (isspace((unsigned char) *p))
+            *in_word = 0;
+        else if (!*in_word) {
+            *in_word = 1;
+            (*words)++;
+        }
+    }
+}
+
+
+/* given input ["wc", "[-l|-w|-c]", "file1", ..., NULL], print line, word, and byte counts */
+int sh_wc(char **args)
+{
+    int fd, i = 1, in_word, show_lines = 0, show_words = 0, show_bytes = 0, status = 0;
+    long lines, words, bytes;
+    struct stat st;
+    ssize_t n;
+    char *buf;
+
+    for (; args[i] && args[i][0] == '-' && args[i][1]; i++) {
+        if (args[i][strspn(args[i] + 1, "lwc") + 1]) {
+            fprintf(stderr, "sh: wc: usage: wc [-l|-w|-c] [file ...]\n");
+            return 1;
+        }
+        show_lines |= strchr(args[i], 'l') != NULL;
+        show_words |= strchr(args[i], 'w') != NULL;
+        show_bytes |= strchr(args[i], 'c') != NULL;
+    }
+    if (!show_lines && !show_words && !show_bytes)
+        show_lines = show_words = show_bytes = 1;
+
+    do {
+        if ((fd = _open_input(args[0], args[i])) < 0) {
+            status = 1;
+            continue;
+        }
+        lines = words = bytes = 0;
+        in_word = 0;
+        if (!show_lines && !show_words && fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+            /* byte counts alone come straight from the size, no need to touch the data */
+            bytes = st.st_size;
+        else if ((buf = malloc(SH_STREAM_BUFFSIZE)) != NULL) {
+            /* plain read() beats mmap here, a full scan would take a page fault per 4K */
+            while ((n = read(fd, buf, SH_STREAM_BUFFSIZE)) != 0) {
+                if (n < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    fprintf(stderr, "sh: wc: %s: %s\n", args[i] ? args[i] : "-", strerror(errno));
+                    status = 1;
+                    break;
+                }
+                bytes += n;
+                _wc_chunk(buf, n, show_words, &lines, &words, &in_word);
+            }
+            free(buf);
+        }
+        else
+            status = 1;
+        _close_input(fd);
+
+        if (show_lines)
+            printf("%7ld ", lines);
+        if (show_words)
+            printf("%7ld ", words);
+        if (show_bytes)
+            printf("%7ld ", bytes);
+        printf("%s\n", args[i] ? args[i] : "");
+    } while (args[i] && args[++i]);
+    fflush(stdout);
+    return status;
+}
+
+
+/* given input ["head", "[-n N|-c N]", "file", NULL], print the first N lines (or bytes) */
+int sh_head(char **args)
+{
+    long count;
+    int fd, bytes, status = 0, i = _parse_count_flags(args, &count, &bytes);
+    size_t len, take;
+    ssize_t n;
+    char *map, *buf, *p, *end;
+
+    if (i < 0 || (fd = _open_input(args[0], args[i])) < 0)
+        return 1;
+    fflush(stdout);
+    if ((map = _map_file(fd, &len)) != NULL) {
+        /* find the end of the N'th line directly in the mapping */
+        take = len;
+        if (bytes)
+            take = (size_t) count < len ? (size_t) count : len;
+        else {
+            for (p = map, end = map + len; count > 0 && p && p < end; count--)
+                if ((p = memchr(p, '\n', end - p)) != NULL)
+                    p++;
+            if (p && count == 0)
+                take = p - map;
+        }
+        if (_write_all(STDOUT_FILENO, map, take) < 0)
+            status = 1;
+        munmap(map, len);
+    }
+    else if ((buf = malloc(SH_STREAM_BUFFSIZE)) != NULL) {
+        /* stream chunks until N lines (or bytes) have been written, then stop reading */
+        while (count > 0 && (n = read(fd, buf, SH_STREAM_BUFFSIZE)) != 0) {
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                fprintf(stderr, "sh: head: %s\n", strerror(errno));
+                status = 1;
+                break;
+            }
+            take = n;
+            if (bytes) {
+                if ((size_t) count < take)
+                    take = count;
+                count -= take;
+            }
+            else {
+                for (p = buf, end = buf + n; count > 0 && (p = memchr(p, '\n', end - p)) != NULL; count--)
+                    p++;
+                if (count == 0)
+                    take = p - buf;
+            }
+            if (_write_all(STDOUT_FILENO, buf, take) < 0) {
+                status = 1;
+                break;
+            }
+        }
+        free(buf);
+    }
+    else
+        status = 1;
+    _close_input(fd);
+    return status;
+}
+
+
+/* given input ["tail", "[-n N|-c N]", "file", NULL], print the last N lines (or bytes) */
+int sh_tail(char **args)
+{
+    long count;
+    int fd, bytes, mapped, status, i = _parse_count_flags(args, &count, &bytes);
+    size_t len;
+    char *data, *p;
+
+    if (i < 0 || (fd = _open_input(args[0], args[i])) < 0)
+        return 1;
+    fflush(stdout);
+    /* regular files are mapped so we only touch the pages at the end, anything else has to be read fully */
+    mapped = (data = _map_file(fd, &len)) != NULL;
+    if (!mapped)
+        data = _read_all(fd, &len);
+    _close_input(fd);
+    if (!data) {
+        fprintf(stderr, "sh: tail: %s\n", strerror(errno));
+        return 1;
+    }
+
+    if (bytes)
+        p = (size_t) count < len ? data + len - count : data;
+    else if (count == 0)
+        p = data + len;
+    else {
+        /* walk backwards over N newlines, ignoring the one that terminates the last line */
+        p = data + len;
+        if (len > 0 && data[len - 1] == '\n')
+            p--;
+        while (count > 0 && p > data) {
+            char *nl = memrchr(data, '\n', p - data);
+            if (!nl) {
+                p = data;
+                break;
+            }
+            if (--count > 0)
+                p = nl;
+            else
+                p = nl + 1;
+        }
+        if (count > 0)
+            p = data;
+    }
+    status = _write_all(STDOUT_FILENO, p, data + len - p) < 0;
+
+    if (mapped)
+        munmap(data, len);
+    else
+        free(data);
+    return status;
+}
+
+
 /* lookup table of builtin funcs, see `sh_execute_builtin for usage */
 int (*builtin_funcs[]) (char**) = {
+    &sh_cat,
     &sh_cd,
     &sh_echo,
     &sh_etime,
+    &sh_exec,
     &sh_exit,
-    &sh_io
+    &sh_head,
+    &sh_history,
+    &sh_io,
+    &sh_limit,
+    &sh_set,
+    &sh_source,
+    &sh_stats,
+    &sh_tail,
+    &sh_wc
 };
 
 
@@ -173,6 +937,16 @@ int is_builtin_cmd(char *arg) {
 }
 
 
+int is_stream_builtin(char *arg) {
+    size_t num_builtins = sizeof(stream_builtin_names) / sizeof(stream_builtin_names[0]);
+    for (int i = 0; i < num_builtins; i++) {
+        if (strcmp(arg, stream_builtin_names[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+
 int sh_execute_builtin(char **args)
 {
     size_t num_builtins = sizeof(builtin_func_names) / sizeof(builtin_func_names[0]);
@@ -181,5 +955,5 @@ int sh_execute_builtin(char **args)
             return (*builtin_funcs[i])(args);
         }
     }
-    return 0;
+    return 127;
 }
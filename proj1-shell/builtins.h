@@ -1,9 +1,12 @@
 /* the names of the builtin funcs we have implemented */
 extern char *builtin_func_names[];
 
-/* the table referring to the builtin funcs */
+/* the table referring to the builtin funcs, each returns its exit status (0 on success), `exit` SH_BUILTIN_EXIT */
 extern int (*builtin_funcs[]) (char **);
 
+/* returned by `exit`, the shell ends */
+#define SH_BUILTIN_EXIT -1
+
 
 /**
  *
@@ -35,13 +38,84 @@ int sh_echo(char ** args);
 int sh_io(char ** args);
 
 
+/**
+ * sh_history - print the last N history entries (`history [N]`), or reverse search them (`history -s pattern [N]`)
+ */
+int sh_history(char **args);
+
+
+/**
+ * sh_exec - replace the shell with an external command, keeping any redirections (no fork)
+ */
+int sh_exec(char **args);
+
+
+/**
+ * sh_source - execute a file line by line in the current shell
+ */
+int sh_source(char **args);
+
+
+/**
+ * sh_limit - execute a command under rlimits (cpu=, as=, nofile=) and, if cgroup v2 is writable, in its own cgroup
+ *            with memory.max (mem=) and cpu.max (cpumax=), then report its peak memory and throttled cpu time
+ * e.g. limit cpu=10 mem=512M cpumax=50 /usr/bin/make
+ */
+int sh_limit(char **args);
+
+
+/**
+ * sh_set - set (-o) or unset (+o) a shell option (`trace`, `errexit`), `-e`/`+e` toggle errexit
+ */
+int sh_set(char **args);
+
+
+/**
+ * sh_stats - print the per-phase latency histograms gathered by `set -o trace`
+ */
+int sh_stats(char **args);
+
+
+/**
+ * sh_cat - concatenate files (or stdin) to stdout without forking `cat`
+ * NOTE: regular files are copied with sendfile, so the data never passes through the shell
+ */
+int sh_cat(char **args);
+
+
+/**
+ * sh_wc - print line, word, and byte counts of files (or stdin), supports -l, -w, -c
+ */
+int sh_wc(char **args);
+
+
+/**
+ * sh_head - print the first N lines (-n N, default 10) or bytes (-c N) of a file (or stdin)
+ */
+int sh_head(char **args);
+
+
+/**
+ * sh_tail - print the last N lines (-n N, default 10) or bytes (-c N) of a file (or stdin)
+ */
+int sh_tail(char **args);
+
+
 /**
  * is_builtin_cmd - return whether `arg` is a builtin we have defined
  */
 int is_builtin_cmd(char *arg);
 
+
+/**
+ * is_stream_builtin - return whether `arg` is a builtin that only reads input and writes stdout (cat, head, tail, wc)
+ * NOTE: these run in a forked child (without exec) when they are a stage of a pipeline
+ */
+int is_stream_builtin(char *arg);
+
 /**
  * sh_execute_builtin - looks up command in `builtin_funcs` table and calls it
  * @args: the args of the command
+ * @return: the builtin's exit status, or SH_BUILTIN_EXIT for `exit`
  */
 int sh_execute_builtin(char **args);
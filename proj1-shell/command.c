@@ -1,3 +1,4 @@
+#define _GNU_SOURCE   /* pipe2 */
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -8,6 +9,7 @@
 #include <sys/types.h>
 #include "command.h"
 #include "builtins.h"
+#include "trace.h"
 
 
 /*
@@ -66,6 +68,7 @@ CommandGroup *command_group_create()
     CommandGroup *cmd_grp = calloc(1, sizeof(CommandGroup));
     cmd_grp->commands = calloc(255 + 1, sizeof(Command*));
     cmd_grp->unreaped_pids = calloc(255 + 1, sizeof(pid_t*));
+    cmd_grp->exit_statuses = calloc(255 + 1, sizeof(int));
     cmd_grp->num_unreaped_pids = 0;
     cmd_grp->capacity = 255;
     cmd_grp->num_commands = 0;
@@ -116,9 +119,12 @@ void command_group_append_command(CommandGroup *cmd_grp, Command *cmd)
  */
 void command_group_execute(CommandGroup *cmd_grp)
 {
-    /* save stdin and stdout for later restoration */
-    int ret, fdout, fdin, tmp_stdin = dup(0), tmp_stdout = dup(1);
+    /* save stdin and stdout for later restoration, close-on-exec so `exec` and the stages' commands don't inherit them */
+    int ret, fdout, fdin, tmp_stdin = fcntl(0, F_DUPFD_CLOEXEC, 0), tmp_stdout = fcntl(1, F_DUPFD_CLOEXEC, 0);
     pid_t pid;
+    /* pid of each forked stage, so every stage's exit status can be collected */
+    pid_t *stage_pids = calloc(cmd_grp->num_commands, sizeof(pid_t));
+    uint64_t trace_start = trace_begin();
 
     /* set initial input, handling input redireciton if present */
     if (cmd_grp->fin)
@@ -141,8 +147,9 @@ void command_group_execute(CommandGroup *cmd_grp)
         }
         /* pipe otherwise */
         else {
+            /* close-on-exec, or every stage would hold the read end of its own output and never see SIGPIPE */
             int fd[2];
-            pipe(fd);
+            pipe2(fd, O_CLOEXEC);
             fdout = fd[1];
             fdin = fd[0];
         }
@@ -151,11 +158,37 @@ void command_group_execute(CommandGroup *cmd_grp)
         dup2(fdout, 1);
         close(fdout);
 
-        if (is_builtin_cmd(cmd_grp->commands[i]->args[0])) {
+        if (is_stream_builtin(cmd_grp->commands[i]->args[0]) &&
+            (cmd_grp->num_commands > 1 || cmd_grp->background)) {
+            /* pipeline stage: run the builtin in a child so it streams concurrently with its neighbours, no exec */
+            pid = fork();
+            if (pid == -1){
+                perror("failed to fork");
+                exit(1);
+            }
+            else if (pid == 0) {
+                if (i == 0 && cmd_grp->background)
+                    setpgid(0, 0);
+                /* no exec to drop it, close the read end of our output pipe by hand */
+                if (i < cmd_grp->num_commands - 1)
+                    close(fdin);
+                ret = sh_execute_builtin(cmd_grp->commands[i]->args);
+                fflush(stdout);
+                _exit(ret);
+            }
+            else {
+                cmd_grp->unreaped_pids[cmd_grp->num_unreaped_pids++] = pid;
+                stage_pids[i] = pid;
+            }
+        }
+        else if (is_builtin_cmd(cmd_grp->commands[i]->args[0])) {
             /* call builtin, no forking */
-            int ret = sh_execute_builtin(cmd_grp->commands[i]->args);
-            if (!ret)
+            ret = sh_execute_builtin(cmd_grp->commands[i]->args);
+            /* flush before stdout gets restored, otherwise the output lands on the terminal instead of the pipe */
+            fflush(stdout);
+            if (ret == SH_BUILTIN_EXIT)
                 exit(0);
+            cmd_grp->exit_statuses[i] = ret;
         }
         else {
             /* create child ps */
@@ -176,6 +209,7 @@ void command_group_execute(CommandGroup *cmd_grp)
             else {
                 /* for bg processing, add pid to array for later printing out */
                 cmd_grp->unreaped_pids[cmd_grp->num_unreaped_pids++] = pid;
+                stage_pids[i] = pid;
             }
         }
 
@@ -186,13 +220,34 @@ void command_group_execute(CommandGroup *cmd_grp)
     dup2(tmp_stdout, 1);
     close(tmp_stdin);
     close(tmp_stdout);
+    trace_end(TRACE_SPAWN, trace_start);
     int status;
-    if (!cmd_grp->background)
-        waitpid(pid, &status, 0);
+    if (!cmd_grp->background) {
+        /* wait on every stage, not just the last, so no stage is left as a zombie and each has a status */
+        trace_start = trace_begin();
+        for (int i = 0; i < cmd_grp->num_commands; i++) {
+            if (stage_pids[i] <= 0 || waitpid(stage_pids[i], &status, 0) < 0)
+                continue;
+            if (WIFEXITED(status))
+                cmd_grp->exit_statuses[i] = WEXITSTATUS(status);
+            else if (WIFSIGNALED(status))
+                cmd_grp->exit_statuses[i] = 128 + WTERMSIG(status);
+        }
+        trace_end(TRACE_WAIT, trace_start);
+    }
+    free(stage_pids);
 }
 
 
 
+int command_group_status(CommandGroup *cmd_grp)
+{
+    if (cmd_grp->num_commands == 0)
+        return 0;
+    return cmd_grp->exit_statuses[cmd_grp->num_commands - 1];
+}
+
+
 /*
  * Deallocate all memory the CommandGroup had allocated
  */
@@ -202,6 +257,7 @@ void command_group_free(CommandGroup *cmd_grp)
         command_free(cmd_grp->commands[i]);
     free(cmd_grp->commands);
     free(cmd_grp->unreaped_pids);
+    free(cmd_grp->exit_statuses);
     free(cmd_grp);
 }
 
@@ -49,6 +49,7 @@ typedef struct {
     Command** commands;
     size_t num_unreaped_pids;
     pid_t* unreaped_pids; /* for tracking background processes */
+    int* exit_statuses;   /* exit status of each command, filled in once a foreground group has been waited on */
     char* fin;
     char* fout;
     char* ferr;
@@ -81,6 +82,13 @@ void command_group_append_command(CommandGroup *cmd_grp, Command *cmd);
 void command_group_execute(CommandGroup *cmd_grp);
 
 
+/**
+ * command_group_status - exit status of the last command of a foreground CommandGroup (like bash without pipefail)
+ * NOTE: builtins count with the status they return, a child killed by a signal counts as 128 + signal
+ */
+int command_group_status(CommandGroup *cmd_grp);
+
+
 /**
  * command_group_free - free the enitre CommandGroup
  */
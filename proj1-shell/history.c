@@ -0,0 +1,279 @@
+#define _GNU_SOURCE   /* memmem, mremap */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+#define HISTORY_FILENAME ".sh_history"
+#define HISTORY_TABLE_INIT 4096     /* initial slots of the trigram table, must be a power of two */
+
+/* posting list: ids of the entries containing a trigram, in increasing order */
+typedef struct {
+    uint32_t trigram;               /* the 3 bytes packed, +1 so that 0 means an empty slot */
+    uint32_t num_ids;
+    uint32_t capacity;
+    uint32_t *ids;
+} TrigramPostings;
+
+static int hist_fd = -1;
+static char *hist_map;              /* read-only mapping of the log, grown as the file grows */
+static size_t hist_map_len;
+static size_t hist_indexed;         /* bytes of the log (whole lines only) that have been indexed */
+static off_t hist_own_last = -1;    /* offset of the entry this shell appended last, -1 if none */
+
+static uint64_t *hist_offsets;      /* start offset of every entry */
+static size_t hist_num_entries;
+static size_t hist_capacity;
+
+static TrigramPostings *hist_table; /* open addressing, NULL until the first search */
+static size_t hist_table_size;
+static size_t hist_table_used;
+
+
+void history_init()
+{
+    char *path = getenv("SH_HISTFILE"), *home = getenv("HOME"), *default_path = NULL;
+    if (!path || !path[0]) {
+        if (!home)
+            return;
+        default_path = malloc(strlen(home) + strlen(HISTORY_FILENAME) + 2);
+        sprintf(default_path, "%s/%s", home, HISTORY_FILENAME);
+        path = default_path;
+    }
+    hist_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (hist_fd < 0)
+        perror("sh: history disabled, failed to open history file");
+    free(default_path);
+}
+
+
+void history_append(const char *line)
+{
+    size_t len = strlen(line);
+    char *entry;
+    if (hist_fd < 0 || len == 0)
+        return;
+    /* a single write, so concurrent shells never interleave inside an entry */
+    entry = malloc(len + 1);
+    memcpy(entry, line, len);
+    entry[len] = '\n';
+    if (write(hist_fd, entry, len + 1) < 0)
+        perror("sh: failed to append history");
+    else if ((hist_own_last = lseek(hist_fd, 0, SEEK_CUR)) >= 0)
+        /* O_APPEND leaves our file position just past what we wrote, wherever other shells' lines went */
+        hist_own_last -= len + 1;
+    free(entry);
+}
+
+
+/* length of entry `i` without its newline */
+static size_t _entry_len(size_t i)
+{
+    uint64_t end = i + 1 < hist_num_entries ? hist_offsets[i + 1] : hist_indexed;
+    return end - hist_offsets[i] - 1;
+}
+
+
+static uint32_t _trigram_hash(uint32_t trigram)
+{
+    return trigram * 2654435761u;
+}
+
+
+static TrigramPostings *_table_slot(TrigramPostings *table, size_t size, uint32_t trigram)
+{
+    size_t i = _trigram_hash(trigram) & (size - 1);
+    while (table[i].trigram && table[i].trigram != trigram)
+        i = (i + 1) & (size - 1);
+    return &table[i];
+}
+
+
+static int _table_grow()
+{
+    size_t new_size = hist_table_size ? hist_table_size * 2 : HISTORY_TABLE_INIT;
+    TrigramPostings *new_table = calloc(new_size, sizeof(TrigramPostings));
+    if (!new_table)
+        return -1;
+    for (size_t i = 0; i < hist_table_size; i++)
+        if (hist_table[i].trigram)
+            *_table_slot(new_table, new_size, hist_table[i].trigram) = hist_table[i];
+    free(hist_table);
+    hist_table = new_table;
+    hist_table_size = new_size;
+    return 0;
+}
+
+
+/* add entry `id` to the posting list of every trigram it contains */
+static void _index_entry(uint32_t id)
+{
+    const unsigned char *s = (const unsigned char *) hist_map + hist_offsets[id];
+    size_t len = _entry_len(id);
+    TrigramPostings *slot;
+    uint32_t trigram, *ids;
+    for (size_t i = 0; i + 3 <= len; i++) {
+        /* keep the load factor under 1/2 */
+        if (hist_table_used * 2 >= hist_table_size && _table_grow() < 0)
+            return;
+        trigram = ((uint32_t) s[i] << 16 | (uint32_t) s[i + 1] << 8 | s[i + 2]) + 1;
+        slot = _table_slot(hist_table, hist_table_size, trigram);
+        if (!slot->trigram) {
+            slot->trigram = trigram;
+            hist_table_used++;
+        }
+        /* ids only ever increase, so a repeated trigram in the same entry is always the last id */
+        if (slot->num_ids && slot->ids[slot->num_ids - 1] == id)
+            continue;
+        if (slot->num_ids == slot->capacity) {
+            ids = realloc(slot->ids, (slot->capacity ? slot->capacity * 2 : 4) * sizeof(uint32_t));
+            if (!ids)
+                return;
+            slot->ids = ids;
+            slot->capacity = slot->capacity ? slot->capacity * 2 : 4;
+        }
+        slot->ids[slot->num_ids++] = id;
+    }
+}
+
+
+/* forget everything indexed, the log was truncated or rotated under us */
+static void _history_reset()
+{
+    for (size_t i = 0; i < hist_table_size; i++)
+        free(hist_table[i].ids);
+    free(hist_table);
+    hist_table = NULL;
+    hist_table_size = hist_table_used = 0;
+    if (hist_map)
+        munmap(hist_map, hist_map_len);
+    hist_map = NULL;
+    hist_map_len = hist_indexed = hist_num_entries = 0;
+    hist_own_last = -1;
+}
+
+
+/**
+ * bring the mapping and the indexes up to date with the log, only the lines appended since the last sync are scanned
+ * @return: 0 on success, -1 if history is unavailable
+ */
+static int _history_sync()
+{
+    struct stat st;
+    char *p, *end, *nl, *map;
+    uint64_t *offsets;
+    size_t first_new;
+
+    if (hist_fd < 0 || fstat(hist_fd, &st) < 0)
+        return -1;
+    if ((size_t) st.st_size == hist_indexed)
+        return 0;
+    /* another shell truncated the log, the pages past its end would SIGBUS: start over from the new contents */
+    if ((size_t) st.st_size < hist_indexed)
+        _history_reset();
+    first_new = hist_num_entries;
+
+    if ((size_t) st.st_size > hist_map_len) {
+        if (hist_map)
+            map = mremap(hist_map, hist_map_len, st.st_size, MREMAP_MAYMOVE);
+        else
+            map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, hist_fd, 0);
+        if (map == MAP_FAILED)
+            return -1;
+        hist_map = map;
+        hist_map_len = st.st_size;
+    }
+
+    /* only whole lines are indexed, a partially written one is picked up on the next sync */
+    end = hist_map + st.st_size;
+    for (p = hist_map + hist_indexed; p < end && (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1) {
+        if (hist_num_entries == hist_capacity) {
+            offsets = realloc(hist_offsets, (hist_capacity ? hist_capacity * 2 : 1024) * sizeof(uint64_t));
+            if (!offsets)
+                break;
+            hist_offsets = offsets;
+            hist_capacity = hist_capacity ? hist_capacity * 2 : 1024;
+        }
+        hist_offsets[hist_num_entries++] = p - hist_map;
+        hist_indexed = nl + 1 - hist_map;
+    }
+
+    /* the trigram index only exists once someone searched, after that keep it current */
+    if (hist_table)
+        for (size_t i = first_new; i < hist_num_entries; i++)
+            _index_entry(i);
+    return 0;
+}
+
+
+void history_print(long n)
+{
+    size_t first = 0;
+    if (_history_sync() < 0)
+        return;
+    if (n > 0 && (size_t) n < hist_num_entries)
+        first = hist_num_entries - n;
+    for (size_t i = first; i < hist_num_entries; i++)
+        printf("%5zu  %.*s\n", i + 1, (int) _entry_len(i), hist_map + hist_offsets[i]);
+    fflush(stdout);
+}
+
+
+/* print entry `i` if it contains `pattern`, returns whether it matched. Never this shell's last line, the search */
+static int _try_match(size_t i, const char *pattern, size_t pattern_len)
+{
+    if ((off_t) hist_offsets[i] == hist_own_last)
+        return 0;
+    if (!memmem(hist_map + hist_offsets[i], _entry_len(i), pattern, pattern_len))
+        return 0;
+    printf("%5zu  %.*s\n", i + 1, (int) _entry_len(i), hist_map + hist_offsets[i]);
+    return 1;
+}
+
+
+long history_search(const char *pattern, long limit)
+{
+    const unsigned char *s = (const unsigned char *) pattern;
+    size_t len = strlen(pattern);
+    TrigramPostings *slot, *rarest = NULL;
+    uint32_t trigram;
+    long found = 0;
+
+    if (_history_sync() < 0)
+        return 0;
+
+    if (len < 3) {
+        /* too short for the trigram index, scan backwards */
+        for (size_t i = hist_num_entries; i > 0 && found < limit; i--)
+            found += _try_match(i - 1, pattern, len);
+        fflush(stdout);
+        return found;
+    }
+
+    if (!hist_table) {
+        /* first search, index everything that has been synced so far */
+        if (_table_grow() < 0)
+            return 0;
+        for (size_t i = 0; i < hist_num_entries; i++)
+            _index_entry(i);
+    }
+
+    /* every match contains all of the pattern's trigrams, so only the rarest one's postings need checking */
+    for (size_t i = 0; i + 3 <= len; i++) {
+        trigram = ((uint32_t) s[i] << 16 | (uint32_t) s[i + 1] << 8 | s[i + 2]) + 1;
+        slot = _table_slot(hist_table, hist_table_size, trigram);
+        if (!slot->trigram)
+            return 0;
+        if (!rarest || slot->num_ids < rarest->num_ids)
+            rarest = slot;
+    }
+    for (size_t i = rarest->num_ids; i > 0 && found < limit; i--)
+        found += _try_match(rarest->ids[i - 1], pattern, len);
+    fflush(stdout);
+    return found;
+}
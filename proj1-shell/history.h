@@ -0,0 +1,34 @@
+#include <stddef.h>
+/*
+ * Command history, kept in an append-only log file ($SH_HISTFILE, default ~/.sh_history) with one line per entry
+ * Startup only opens the file: the log is mmap'd and indexed lazily the first time `history` needs it, and after
+ * that only the newly appended tail is indexed (a log truncated by another shell is indexed again from scratch).
+ * Reverse search uses a trigram index built on the first search.
+ */
+
+
+/**
+ * history_init - open (creating if needed) the history log, O(1) regardless of the history size
+ */
+void history_init();
+
+
+/**
+ * history_append - append an accepted line to the log
+ * NOTE: lines are written with O_APPEND, so several shells can share one log
+ */
+void history_append(const char *line);
+
+
+/**
+ * history_print - print the last `n` entries with their numbers, all of them if `n` <= 0
+ */
+void history_print(long n);
+
+
+/**
+ * history_search - print up to `limit` entries containing `pattern`, most recent first, leaving out the line this shell
+ * appended last (the `history -s` being run)
+ * @return: the number of matches printed
+ */
+long history_search(const char *pattern, long limit);
@@ -12,6 +12,8 @@
 #include "shell.h"
 #include "builtins.h"
 #include "utils.h"
+#include "trace.h"
+#include "history.h"
 
 
 #define SH_LINE_BUFFSIZE 255
@@ -29,17 +31,32 @@ void _print_args(char** args)
 }
 
 
-char *sh_read_line()
+char *sh_read_line(FILE *in, bool *too_long)
 {
     char *buffer = calloc(SH_LINE_BUFFSIZE, sizeof(char));
     size_t ix = 0;
-    char c;
+    int c;
+    *too_long = false;
     while(1) {
-        c = getchar();
-        if (c == '\n') {
+        /* stdio buffers `in`, so a sourced file is read a block at a time rather than a syscall per char */
+        c = getc(in);
+        if (c == EOF && ix == 0) {
+            free(buffer);
+            return NULL;
+        }
+        if (c == '\n' || c == EOF) {
             buffer[ix] = '\0';
             return buffer;
         }
+        /* running the part that fit would run a cut off command, and the rest as another one */
+        if (ix == SH_LINE_BUFFSIZE - 1) {
+            while (c != '\n' && c != EOF)
+                c = getc(in);
+            fprintf(stderr, "sh: line too long, the limit is %d characters\n", SH_LINE_BUFFSIZE - 1);
+            *too_long = true;
+            buffer[0] = '\0';
+            return buffer;
+        }
         else
             buffer[ix] = c;
         ix++;
@@ -176,13 +193,19 @@ char **sh_expand_env_vars(char** args)
 
 
 /**
- * we define a command as an argument that is the first tokenm directly after a pipe '|', or after `etime` or `io`
+ * we define a command as an argument that is the first tokenm directly after a pipe '|', or after `etime`, `io`, `exec`
+ * or `limit` (and its options)
  * return 0: arg, 1: cd 2: built-in command, 3: external command
  */
 int _is_command(char **args, int i)
 {
-    if (i != 0 && strcmp(args[i - 1], "|") != 0 &&
-        strcmp(args[i - 1], "etime") != 0 && strcmp(args[i - 1], "io") != 0)
+    /* `limit` takes key=value options before its command, skip back over them */
+    int j = i - 1;
+    while (j > 0 && strchr(args[j], '='))
+        j--;
+    bool after_limit = i != 0 && strcmp(args[j], "limit") == 0 && !strchr(args[i], '=');
+    if (i != 0 && strcmp(args[i - 1], "|") != 0 && strcmp(args[i - 1], "etime") != 0 &&
+        strcmp(args[i - 1], "io") != 0 && strcmp(args[i - 1], "exec") != 0 && !after_limit)
         return 0;
     else if (strcmp(args[i], "cd") == 0)
         return 1;
@@ -285,7 +308,7 @@ char** sh_expand_paths(char** args)
             }
             else if (arg_type == 3) {
                 /* expand external commands */
-                /* built-ins `etime` and `io` also expect a external command as their first arg */
+                /* built-ins `etime`, `io`, `exec` and `limit` also expect a external command as their first arg */
                 char *expanded_path = _expand_external_command(arg);
                 /* error out on broken path  */
                 if (!expanded_path) {
@@ -297,8 +320,8 @@ char** sh_expand_paths(char** args)
                 expanded_args[i] = expanded_path;
             }
         }
-        /* cd's first args (if present) needs to be expanded */
-        else if (i > 0 && strcmp(args[i - 1], "cd") == 0) {
+        /* cd's and source's first args (if present) needs to be expanded */
+        else if (i > 0 && (strcmp(args[i - 1], "cd") == 0 || strcmp(args[i - 1], "source") == 0)) {
             if (strchr(arg, '/') || strchr(arg, '~') || strchr(arg, '.')){
                 char *expanded_path = _resolve_path(arg);
                 if (!expanded_path) {
@@ -399,56 +422,149 @@ void sh_reap_zombies(CommandGroup** bg_cmd_grp_queue)
 }
 
 
-void sh_loop()
+/* the queue of background CommandGroups, shared by the main loop and sourced files */
+static CommandGroup **bg_cmd_grp_queue;
+
+/* `set -e`, stop on the first command that fails */
+bool sh_opt_errexit = false;
+
+
+int sh_execute_line(char *line, bool record)
 {
-    char *line, *whitespaced_line;
+    char *whitespaced_line;
     char **args, **exp_env_args, **exp_path_args;
-    CommandGroup **bg_cmd_grp_queue = calloc(256, sizeof(CommandGroup*));
+    uint64_t trace_start;
+    int status = 0;
 
-    pid_t pid = getpid();
-    do {
-        /* */
-        sh_reap_zombies(bg_cmd_grp_queue);
-        sh_prompt();
-        line = sh_read_line();
+    trace_start = trace_begin();
+    whitespaced_line = sh_add_whitespace(line, SH_SPECIAL_CHARS);
+    trace_end(TRACE_WHITESPACE, trace_start);
 
-        whitespaced_line = sh_add_whitespace(line, SH_SPECIAL_CHARS);
+    trace_start = trace_begin();
+    args = sh_parse_line(whitespaced_line);
+    trace_end(TRACE_TOKENIZE, trace_start);
 
-        args = sh_parse_line(whitespaced_line);
+    /* nothing to run (only whitespace), not a failure */
+    if (!args[0]) {
+        free(whitespaced_line); _free2d(args);
+        return 0;
+    }
 
-        if (!_is_well_formed(args)) {
-            free(line); free(whitespaced_line); _free2d(args);
-            continue;
-        }
+    trace_start = trace_begin();
+    if (!_is_well_formed(args)) {
+        free(whitespaced_line); _free2d(args);
+        return -1;
+    }
+    trace_end(TRACE_WELL_FORMED, trace_start);
+    if (record)
+        history_append(line);
+
+    /* expand env variables */
+    trace_start = trace_begin();
+    exp_env_args = sh_expand_env_vars(args);
+    if (!exp_env_args) {
+        free(whitespaced_line); _free2d(args);
+        return -1;
+    }
+    trace_end(TRACE_EXPAND_ENV, trace_start);
+
+    /* expand commands to absolute paths */
+    trace_start = trace_begin();
+    exp_path_args = sh_expand_paths(exp_env_args);
+    if (!exp_path_args){
+        free(whitespaced_line); _free2d(args); _free2d(exp_env_args);
+        return -1;
+    }
+    trace_end(TRACE_EXPAND_PATHS, trace_start);
+
+    /* create command group and execute */
+    trace_start = trace_begin();
+    CommandGroup * cmd_grp = command_group_from_args(exp_path_args);
+    trace_end(TRACE_BUILD_GROUP, trace_start);
+    /* actual execution, traces its own spawn and wait phases */
+    command_group_execute(cmd_grp);
+    /* background cmd_grp's get free'd when all their child pids are reaped */
+    if (cmd_grp->background){
+
+        eq_append(bg_cmd_grp_queue, cmd_grp);
+    }
+    else {
+        status = command_group_status(cmd_grp);
+        command_group_free(cmd_grp);
+    }
+    /* cleanup */
+    free(whitespaced_line); _free2d(args);
+    _free2d(exp_env_args); _free2d(exp_path_args);
+    return status;
+}
 
-        /* expand env variables */
-        exp_env_args = sh_expand_env_vars(args);
-        if (!exp_env_args) {
-            free(line); free(whitespaced_line); _free2d(args);
-            continue;
-        }
 
-        /* expand commands to absolute paths */
-        exp_path_args = sh_expand_paths(exp_env_args);
-        if (!exp_path_args){
-            free(line); free(whitespaced_line); _free2d(args); _free2d(exp_env_args);
-            continue;
-        }
+/* with `set -e`, a failed line ends the shell with its status (a parse error counts as status 1) */
+static void _check_errexit(int status)
+{
+    if (sh_opt_errexit && status != 0)
+        exit(status > 0 ? status : 1);
+}
 
-        /* create command group and execute */
-        CommandGroup * cmd_grp = command_group_from_args(exp_path_args);
-        /* actual execution */
-        command_group_execute(cmd_grp);
-        /* background cmd_grp's get free'd when all their child pids are reaped */
-        if (cmd_grp->background){
 
-            eq_append(bg_cmd_grp_queue, cmd_grp);
+/* blank lines and comments are skipped before execution, _is_well_formed would report them as parsing errors */
+static bool _is_blank_line(const char *line)
+{
+    const char *first = line + strspn(line, SH_TOKEN_DELIMS);
+    return !*first || *first == '#';
+}
+
+
+int sh_source_file(char *path)
+{
+    char *line;
+    bool too_long;
+    int status = 0;
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "sh: source: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    while ((line = sh_read_line(in, &too_long)) != NULL) {
+        if (too_long) {
+            status = 1;
+            _check_errexit(status);
         }
-        else
-            command_group_free(cmd_grp);
-        /* cleanup */
-        free(line); free(whitespaced_line); _free2d(args);
-        _free2d(exp_env_args); _free2d(exp_path_args);
+        else if (!_is_blank_line(line)) {
+            status = sh_execute_line(line, false);
+            _check_errexit(status);
+        }
+        free(line);
+    }
+    fclose(in);
+    return status;
+}
+
+
+void sh_loop()
+{
+    char *line;
+    bool too_long;
+    uint64_t trace_start;
+    bg_cmd_grp_queue = calloc(256, sizeof(CommandGroup*));
+
+    pid_t pid = getpid();
+    do {
+        /* */
+        sh_reap_zombies(bg_cmd_grp_queue);
+        sh_prompt();
+        trace_start = trace_begin();
+        line = sh_read_line(stdin, &too_long);
+        trace_end(TRACE_READ, trace_start);
+        /* end of input, same as `exit` */
+        if (!line)
+            break;
+
+        if (too_long)
+            _check_errexit(1);
+        else if (!_is_blank_line(line))
+            _check_errexit(sh_execute_line(line, true));
+        free(line);
 
     } while(1);
     free(bg_cmd_grp_queue);
@@ -458,6 +574,8 @@ void sh_loop()
 
 int main(int argc, char **argv)
 {
+    trace_init();
+    history_init();
     sh_loop();
     return 0;
 }
@@ -1,3 +1,5 @@
+#include <stdio.h>
+#include <stdbool.h>
 #include "command.h"
 /**
  * Functions responsible for controlling the event loop of the shell, involving prompting, parsing, and executing
@@ -102,11 +104,12 @@ char *_match_path(char *executable);
 
 
 /**
- * sh_read_line - read shell user input from stdin
- * @return: char * to beginning of line
- * Assumption: The user input will be no more than 255 characters
+ * sh_read_line - read a line of input from `in` (stdin for the user, a FILE for `source`)
+ * @too_long: set when the line was longer than 254 characters. It is reported and thrown away up to its newline, and
+ *            comes back empty, so no part of it is run
+ * @return: char * to beginning of line, NULL at end of input
  */
-char *sh_read_line();
+char *sh_read_line(FILE *in, bool *too_long);
 
 
 /**
@@ -181,6 +184,27 @@ void sh_reap_zombies(CommandGroup** bg_cmd_grp_queue);
 void sh_prompt();
 
 
+/* set by `set -e`, a failing command ends the shell */
+extern bool sh_opt_errexit;
+
+
+/**
+ * sh_execute_line - run one line through the parsing pipeline and execute it
+ * @line: the raw line as read by `sh_read_line`
+ * @record: whether to append the line to the history (not for lines of a sourced file)
+ * @return: exit status of the last stage of a foreground group (0 for background or an empty line), -1 on a
+ *          parsing/expansion error
+ */
+int sh_execute_line(char *line, bool record);
+
+
+/**
+ * sh_source_file - execute every line of the file at `path` in the current shell, honoring `set -e`
+ * @return: status of the last line executed, 1 if the file couldn't be opened
+ */
+int sh_source_file(char *path);
+
+
 /**
  * sh_loop - loop grabbing commands from the user and executing them
  */
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Regression tests, each feeds a script to ./shell on stdin and checks its exit status and what it printed
+
+checks=0
+failures=0
+big=$(mktemp)
+SH_HISTFILE=$(mktemp)
+export SH_HISTFILE
+seq 1 1000000 > "$big"
+
+# check NAME RC PATTERN SCRIPT: run SCRIPT, it must exit with RC and print PATTERN (or, prefixed with !, not print it)
+check() {
+    checks=$((checks + 1))
+    out=$(printf '%b' "$4" | timeout 10 ./shell 2>&1)
+    rc=$?
+    case "$3" in
+        !*) printf '%s\n' "$out" | grep -q -- "${3#!}" && rc="$rc, printed '${3#!}'" ;;
+        *)  printf '%s\n' "$out" | grep -q -- "$3" || rc="$rc, didn't print '$3'" ;;
+    esac
+    if [ "$rc" != "$2" ]; then
+        echo "FAIL $1: rc=$rc, expected $2"
+        failures=$((failures + 1))
+    fi
+}
+
+# a producer whose reader exits early must get SIGPIPE, not hang the shell (timeout's 124)
+check "yes | head" 0 "> y$" "yes | head -n 1\n"
+check "cat | head" 0 "> 1$" "cat $big | head -n 1\n"
+check "/bin/cat | /usr/bin/head" 0 "> 1$" "/bin/cat $big | /usr/bin/head -n 1\n"
+check "yes | cat | head" 0 "> y$" "yes | cat | head -n 1\n"
+
+# set -e stops on a failing line, but a blank line or a comment isn't one
+check "set -e, blank lines" 0 "> after" "set -e\n\n   \n# comment\necho after\n"
+check "set -e, failing builtin" 1 "!still-alive" "set -e\ncat /nonexistent\necho still-alive\n"
+check "set -e, failing command" 1 "!still-alive" "set -e\n/bin/false\necho still-alive\n"
+
+# the stream builtins fail on unreadable input and unknown options
+check "head of a directory" 1 "!still-alive" "set -e\nhead /tmp\necho still-alive\n"
+check "tail of a directory" 1 "!still-alive" "set -e\ntail /tmp\necho still-alive\n"
+check "wc of a directory" 1 "!still-alive" "set -e\nwc /tmp\necho still-alive\n"
+check "wc -x" 1 "usage: wc" "set -e\nwc -x $big\necho still-alive\n"
+check "head -x" 1 "usage: head" "set -e\nhead -x $big\necho still-alive\n"
+check "wc -lw" 0 "1000000 *1000000 $big" "set -e\nwc -lw $big\n"
+
+rm -f "$big" "$SH_HISTFILE"
+echo "test.sh: $checks checks, $failures failures"
+[ "$failures" -eq 0 ]
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+#define TRACE_RING_SIZE 65536    /* must be a power of two */
+#define TRACE_HIST_BUCKETS 32    /* bucket 0 is < 1us, bucket k is [2^(k-1), 2^k) us */
+
+/* a single completed phase, timestamps in nanoseconds of CLOCK_MONOTONIC_RAW */
+typedef struct {
+    uint64_t start;
+    uint64_t duration;
+    TracePhase phase;
+} TraceEvent;
+
+typedef struct {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[TRACE_HIST_BUCKETS];
+} TraceHistogram;
+
+static const char *TRACE_PHASE_STRINGS[] = {
+    "read", "whitespace", "tokenize", "well_formed", "expand_env", "expand_paths", "build_group", "spawn", "wait"
+};
+
+/*
+ * The shell is single threaded, so the ring only ever has one writer: `head` counts every event ever recorded and
+ * the slot is `head & (size - 1)`, no locking needed. Children that fork off inherit a copy and never write it back.
+ */
+static TraceEvent trace_ring[TRACE_RING_SIZE];
+static uint64_t trace_head;
+static TraceHistogram trace_hists[TRACE_NUM_PHASES];
+static bool trace_enabled;
+static pid_t trace_owner;    /* only the shell itself dumps, not a child that `exit`s after a failed exec */
+
+
+static uint64_t _trace_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static void _trace_dump_at_exit()
+{
+    if (getpid() == trace_owner && trace_head > 0)
+        trace_dump();
+}
+
+
+void trace_init()
+{
+    char *env = getenv("SH_TRACE");
+    trace_owner = getpid();
+    trace_enabled = env && env[0] && strcmp(env, "0") != 0;
+    atexit(_trace_dump_at_exit);
+}
+
+
+void trace_set_enabled(bool enabled)
+{
+    trace_enabled = enabled;
+}
+
+
+bool trace_is_enabled()
+{
+    return trace_enabled;
+}
+
+
+uint64_t trace_begin()
+{
+    return trace_enabled ? _trace_now() : 0;
+}
+
+
+void trace_end(TracePhase phase, uint64_t start)
+{
+    if (!start || !trace_enabled)
+        return;
+    uint64_t duration = _trace_now() - start, us = duration / 1000;
+    TraceEvent *ev = &trace_ring[trace_head++ & (TRACE_RING_SIZE - 1)];
+    ev->start = start;
+    ev->duration = duration;
+    ev->phase = phase;
+
+    /* log2 bucket of the duration in microseconds */
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+    if (bucket >= TRACE_HIST_BUCKETS)
+        bucket = TRACE_HIST_BUCKETS - 1;
+    TraceHistogram *hist = &trace_hists[phase];
+    hist->count++;
+    hist->total += duration;
+    if (duration > hist->max)
+        hist->max = duration;
+    hist->buckets[bucket]++;
+}
+
+
+int trace_dump()
+{
+    char default_path[64], *path = getenv("SH_TRACE_FILE");
+    if (!path || !path[0]) {
+        snprintf(default_path, sizeof(default_path), "/tmp/sh_trace.%d.json", (int) trace_owner);
+        path = default_path;
+    }
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror("sh: failed to write trace");
+        return -1;
+    }
+    /* oldest event first, if the ring wrapped the oldest is the slot about to be overwritten */
+    uint64_t first = trace_head > TRACE_RING_SIZE ? trace_head - TRACE_RING_SIZE : 0;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (uint64_t i = first; i < trace_head; i++) {
+        TraceEvent *ev = &trace_ring[i & (TRACE_RING_SIZE - 1)];
+        fprintf(out, "{\"name\":\"%s\",\"cat\":\"sh\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}%s\n",
+                TRACE_PHASE_STRINGS[ev->phase], ev->start / 1000.0, ev->duration / 1000.0,
+                (int) trace_owner, (int) trace_owner, i + 1 < trace_head ? "," : "");
+    }
+    fprintf(out, "],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(out);
+    return 0;
+}
+
+
+void trace_print_stats()
+{
+    printf("%-14s %10s %12s %12s\n", "phase", "count", "mean (us)", "max (us)");
+    for (int i = 0; i < TRACE_NUM_PHASES; i++) {
+        TraceHistogram *hist = &trace_hists[i];
+        if (!hist->count)
+            continue;
+        printf("%-14s %10llu %12.1f %12.1f\n", TRACE_PHASE_STRINGS[i], (unsigned long long) hist->count,
+               hist->total / 1000.0 / hist->count, hist->max / 1000.0);
+    }
+    for (int i = 0; i < TRACE_NUM_PHASES; i++) {
+        TraceHistogram *hist = &trace_hists[i];
+        if (!hist->count)
+            continue;
+        printf("\n%s:\n", TRACE_PHASE_STRINGS[i]);
+        for (int b = 0; b < TRACE_HIST_BUCKETS; b++) {
+            if (!hist->buckets[b])
+                continue;
+            /* scale the bar to at most 40 chars */
+            int bar = (int) (hist->buckets[b] * 40 / hist->count);
+            printf("  %10llu - %-10llu us %8llu %.*s\n",
+                   b ? 1ULL << (b - 1) : 0ULL, 1ULL << b, (unsigned long long) hist->buckets[b],
+                   bar ? bar : 1, "****************************************");
+        }
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <stdint.h>
+/*
+ * Latency tracing of the phases of `sh_loop`, enabled with SH_TRACE=1 or `set -o trace`
+ * Each phase is timestamped with CLOCK_MONOTONIC_RAW into a fixed size ring buffer (oldest events are overwritten)
+ * and a per-phase log2 histogram. On exit the ring is dumped as Chrome trace_event JSON (chrome://tracing, perfetto)
+ * to $SH_TRACE_FILE, or /tmp/sh_trace.<pid>.json if unset.
+ */
+
+
+typedef enum {
+    TRACE_READ,         /* sh_read_line */
+    TRACE_WHITESPACE,   /* sh_add_whitespace */
+    TRACE_TOKENIZE,     /* sh_parse_line */
+    TRACE_WELL_FORMED,  /* _is_well_formed */
+    TRACE_EXPAND_ENV,   /* sh_expand_env_vars */
+    TRACE_EXPAND_PATHS, /* sh_expand_paths */
+    TRACE_BUILD_GROUP,  /* command_group_from_args */
+    TRACE_SPAWN,        /* fork/exec (or in-process builtin) of every stage in command_group_execute */
+    TRACE_WAIT,         /* waiting on the foreground CommandGroup */
+    TRACE_NUM_PHASES
+} TracePhase;
+
+
+/**
+ * trace_init - enable tracing if SH_TRACE is set, and register the dump on exit
+ */
+void trace_init();
+
+
+/**
+ * trace_set_enabled - turn tracing on or off at runtime (`set -o trace`, `set +o trace`)
+ */
+void trace_set_enabled(bool enabled);
+
+
+/**
+ * trace_is_enabled - returns whether phases are currently being recorded
+ */
+bool trace_is_enabled();
+
+
+/**
+ * trace_begin - returns the start timestamp of a phase, 0 when tracing is disabled
+ */
+uint64_t trace_begin();
+
+
+/**
+ * trace_end - record the phase that started at `start` (from `trace_begin`) into the ring and histogram
+ * NOTE: does nothing if `start` is 0, so a phase that straddles `set -o trace` is dropped rather than misreported
+ */
+void trace_end(TracePhase phase, uint64_t start);
+
+
+/**
+ * trace_dump - write the ring buffer out as Chrome trace_event JSON
+ * @return: 0 on success, -1 if the file couldn't be written
+ */
+int trace_dump();
+
+
+/**
+ * trace_print_stats - print the count, mean, max and log2 histogram (in microseconds) of every phase
+ */
+void trace_print_stats();
@@ -0,0 +1,572 @@
+#ifndef __ELEVATOR_H
+#define __ELEVATOR_H
+
+#include "elevator_platform.h"
+
+/**
+ * Interface of the elevator scheduler core (`elevator_core.c`). The core has no kernel module glue: the module
+ * (`elevator_module.c`) advances every car from a timer and runs the dispatcher in a kthread behind the syscalls and
+ * /proc, the simulator (`sim/`) runs them in userspace.
+ */
+
+#define NUM_PASSENGER_TYPES 4   /* */
+#define MIN_FLOOR 0             /* min floor number, default position */
+#define MAX_NUM_FLOORS 256      /* tallest building the arrays and bitmaps are sized for (floor numbers fit a u8) */
+#define NUM_FLOORS elevator_num_floors          /* floors in the building, see "Building Configuration" */
+#define MAX_FLOOR (elevator_num_floors - 1)     /* max floor number (inclusive) */
+#define TIME_BETWEEN_FLOORS elevator_travel_ms  /* mandatory time spent moving between floors, in ms */
+#define TIME_AT_FLOOR elevator_stop_ms          /* mandatory time spent loading/unloading, in ms */
+#define MAX_LOAD_UNITS elevator_max_load_units  /* max load the elevator can hold in terms on units */
+#define MAX_LOAD_WEIGHT elevator_max_load_weight    /* max load the elevator can hold in terms on weight */
+#define MAX_LOAD_HALF_WEIGHT (2 * MAX_LOAD_WEIGHT)  /* the same in half units, see `Load` */
+#define ARRIVAL_WINDOW 10       /* seconds of arrivals counted before they are folded into a floor's arrival rate */
+#define ARRIVAL_RATE_SHIFT 8    /* arrival rates are fixed point, arrivals per window << ARRIVAL_RATE_SHIFT */
+#define ARRIVAL_EWMA_SHIFT 2    /* each new window is weighted 1 / (1 << ARRIVAL_EWMA_SHIFT) in the average */
+#define MAX_CARS 8              /* most cars in the bank */
+#define LATENCY_BUCKETS 24      /* log2 buckets of milliseconds in a `LatencyHistogram`, the last is ~2.3 hours and up */
+
+
+/**
+ * Lock hierarchy. Take them in this order, and never two of the same class at once:
+ *   0. the module's bank mutex        start_elevator / stop_elevator and the dispatcher thread
+ *   1. `Floor.lock` (mutex)           the floor's queues and metrics
+ *   2. `Elevator.lock` (mutex)        the car's riders, load, state and stats
+ *   3. the /proc snapshot seqlock     taken by `elevator_publish` with the car lock held
+ *   4. the event readers spinlock     taken by the module's `elevator_notify`, under either of the mutexes
+ * Boarding (`elevator_load_floor`) is the only place that holds a floor and a car at once. Everything else that looks
+ * at another thread's data goes without its lock: /proc copies the snapshot under the seqlock's read side, the snapshot
+ * copies the floor metrics under `Floor.seq`, the dispatcher estimates a car's ETA and a parked car picks its floor
+ * from `READ_ONCE`s, and `elevator_notify` checks for readers with `list_empty_careful`. The `floors_*` bitmaps and
+ * each car's `calls` are only changed with atomic bitops. The core never sleeps while holding a spinlock, and every
+ * mutex is taken uninterruptibly: the sections are short, and a lock that may fail has to be checked everywhere.
+ * `testing/elevator6_lockdep` runs the module under lockdep (and KCSAN where the kernel has it).
+ */
+
+
+/**
+ ***********************************************************************************************************************
+ ******************************************** Building Configuration ***************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * The building, set from module parameters (simulator options) before `create_floors_array` and fixed after that. The
+ * defaults are the spec's: 10 floors, 2s between floors, 2s at a floor, 10 units and 15 weight. Times are in ms of
+ * building time, which runs `elevator_time_scale` times faster than real time, so a benchmark can run the unchanged
+ * scheduler 100x faster while every wait, ride and arrival rate still reads in building time.
+ */
+extern int elevator_num_floors;
+extern unsigned int elevator_travel_ms;
+extern unsigned int elevator_stop_ms;
+extern int elevator_max_load_units;
+extern int elevator_max_load_weight;
+extern unsigned int elevator_time_scale;
+
+/**
+ * elevator_config_check - whether the configuration is one the core can run (2 to MAX_NUM_FLOORS floors, a car that
+ * fits the heaviest passenger, a time scale of at least 1), printing what is wrong
+ * @return: 0 if it is, -1 otherwise
+ */
+int elevator_config_check(void);
+
+/* elevator_now_ns - building time in ns, ktime scaled by `elevator_time_scale` */
+u64 elevator_now_ns(void);
+
+
+/**
+ ***********************************************************************************************************************
+ ********************************************** Passenger Interface ****************************************************
+ ***********************************************************************************************************************
+ */
+typedef enum {
+    CHILD,
+    ADULT,
+    BELLHOP,
+    ROOM_SERVICE
+} PassengerType;
+
+
+/**
+ * 40 bytes, allocated from a dedicated slab cache: a passenger is only ever on one list (a floor's inbox, then a
+ * floor's queue, then the car), so the links share storage, and the small fields sit after the timestamps (`id` fits
+ * in what would otherwise be tail padding)
+ */
+typedef struct {
+    union {
+        struct list_head queue;     /* link in one of a floor's queues or the car */
+        struct llist_node inbox;    /* link in the floor's inbox until the elevator thread moves it to the queue */
+    };
+    u64 issued_ns;          /* `elevator_now_ns` when the request was issued */
+    u64 boarded_ns;         /* `elevator_now_ns` when the passenger boarded */
+    u8 passenger_type;
+    u8 destination_floor;
+    u32 id;                 /* sequence number, to tell passengers apart in event streams (wraps) */
+} PassengerNode;
+
+extern const char *PASSENGER_TYPE_STRINGS[];
+
+/**
+ * Aggregate of a group of passengers (a floor's queue or the car), updated in O(1) as passengers come and go. Weight
+ * is fixed point in half units, so a child (0.5) is 1 and every weight in the spec is an exact integer (no FPU in the
+ * kernel). The counter arrays answer "how many of this type / going to that floor" without walking the list.
+ */
+typedef struct {
+    int count;
+    int units;
+    int half_weight;
+    int by_type[NUM_PASSENGER_TYPES];
+    int by_dest[MAX_NUM_FLOORS];
+} Load;
+
+void load_add(Load *load, const PassengerNode *p);
+void load_sub(Load *load, const PassengerNode *p);
+
+/* whether `p` can join `load` without going over the car's limits */
+int load_can_fit(const Load *load, const PassengerNode *p);
+
+/* whole and tenths part of the weight, for printing as "%d.%d" */
+#define LOAD_WEIGHT_WHOLE(load) ((load)->half_weight >> 1)
+#define LOAD_WEIGHT_TENTHS(load) (((load)->half_weight & 1) * 5)
+
+/**
+ * passenger_cache_create - set up the `PassengerNode` slab cache, before anything is issued
+ * @return: 0 on success, -1 if the cache couldn't be created
+ */
+int passenger_cache_create(void);
+void passenger_cache_destroy(void);
+
+PassengerNode *passenger_node_create(PassengerType passenger_type, int destination_floor);
+void passenger_node_free(PassengerNode *p);
+
+
+/**
+ ***********************************************************************************************************************
+ ************************************************ Floor Interface ******************************************************
+ ***********************************************************************************************************************
+ */
+/* the two hall buttons on a floor, which way the passengers queued behind them are going */
+typedef enum {
+    HALL_UP,
+    HALL_DOWN,
+    NUM_HALL_DIRECTIONS
+} HallDirection;
+
+/**
+ * A floor's waiting passengers are kept in a FIFO queue per hall direction and type. The front of a direction's queue
+ * is the earliest of its four heads (`floor_hall_head`), so a car only boards from the queue going its way, and
+ * relaxed boarding can skip every passenger of a type that doesn't fit in one step. `floor_head` is the earliest of
+ * all eight, the passenger who has waited longest whichever way they are going.
+ */
+typedef struct {
+    /* the passengers waiting here (via `PassengerNodes`), by the way they are going and by type */
+    struct list_head queues[NUM_HALL_DIRECTIONS][NUM_PASSENGER_TYPES];
+    struct llist_head inbox;        /* requests posted lock-free by `issue_request`, newest first, not yet in `queue` */
+    struct mutex lock;              /* ensure only one person modifying queue at once */
+    seqcount_t seq;                 /* bumped (under `lock`) around changes to the metrics below that /proc shows */
+    int num_serviced;                /* number of people serviced, **not including** people in queue */
+    int floor_num;
+    Load load;                      /* everyone in `queue`, `load.count` is the number of people waiting */
+    int hall_waiting[NUM_HALL_DIRECTIONS];  /* `load.count` split by the way they are going */
+    int arrivals;                   /* requests issued here in the current arrival window */
+    int arrival_rate;               /* EWMA of `arrivals` per window, fixed point (see ARRIVAL_RATE_SHIFT) */
+    int car;                        /* car the dispatcher assigned this floor's hall call to, -1 if none (`lock`) */
+} Floor;
+
+/* global variable that holds the array of `Floor`s */
+extern Floor **floors;
+
+/* bit `i` is set while floor `i` has someone waiting in its queue or inbox, read without locks */
+extern DECLARE_BITMAP(floors_waiting, MAX_NUM_FLOORS);
+
+/**
+ * bit `i` is set when floor `i` may have someone waiting without a car assigned: on every post, and when a car leaves
+ * people behind. The dispatcher clears it as it assigns calls.
+ */
+extern DECLARE_BITMAP(floors_unassigned, MAX_NUM_FLOORS);
+
+/* the dispatcher sleeps here until `floors_unassigned` has a bit set (or it is told to stop) */
+extern wait_queue_head_t floors_waitq;
+
+Floor *floor_create(int floor_num);
+void floor_free(Floor* floor);
+Floor** create_floors_array(int num_floors);
+void free_floors_array(Floor** floors, int num_floors);
+void floor_enqueue_passenger(Floor* floor, PassengerNode* p);
+
+/**
+ * floor_post_passenger - lock-free enqueue for any number of producers, the passenger lands in the floor's inbox and
+ * reaches the queue (and the floor metrics) once the dispatcher calls `floors_drain_inboxes`
+ */
+void floor_post_passenger(Floor *floor, PassengerNode *p);
+
+/**
+ * floor_post_batch - `floor_post_passenger` for a chain of passengers linked through `inbox`, newest `first`
+ */
+void floor_post_batch(Floor *floor, struct llist_node *first, struct llist_node *last);
+
+/**
+ * floors_drain_inboxes - move every floor's posted requests into its queue in arrival order
+ * NOTE: single consumer, only the dispatcher may call this
+ */
+void floors_drain_inboxes(void);
+
+/* floor_hall - the queue `p` waits in on `floor`, by whether they are going up or down from it */
+HallDirection floor_hall(Floor *floor, PassengerNode *p);
+
+/**
+ * floor_head - the passenger who has waited longest on `floor`, NULL if nobody is waiting
+ * NOTE: caller should hold `floor` lock
+ */
+PassengerNode *floor_head(Floor *floor);
+
+/**
+ * floor_hall_head - the passenger going `hall` who has waited longest on `floor`, NULL if nobody is
+ * NOTE: caller should hold `floor` lock
+ */
+PassengerNode *floor_hall_head(Floor *floor, HallDirection hall);
+PassengerNode* floor_dequeue_passenger(Floor *floor, PassengerNode *p);
+void floor_print(Floor* floor);
+void print_floors_array(Floor** floors, int num_floors);
+
+/**
+ * floors_update_arrival_rates - close every arrival window that ended by `now` (ns) and fold it into the floors' EWMAs
+ */
+void floors_update_arrival_rates(u64 now);
+
+
+/**
+ ***********************************************************************************************************************
+ *********************************************** Elevator Interface ****************************************************
+ ***********************************************************************************************************************
+ */
+typedef enum {
+    OFFLINE,    /* elevator isn't running but the module is loaded (initial state) */
+    IDLE,       /* elevator is stopped on a floor because there are no more passengers to service */
+    LOADING,    /* elevator is stopped on a floor to load and unload passengers */
+    UP,         /* elevator is moving from a lower floor to a higher floor */
+    DOWN        /* elevator is moving from a higher floor to a lower floor */
+} ElevatorState;
+
+extern const char *ELEVATOR_STATE_STRINGS[];
+
+/* what the car is waiting on between two steps of `elevator_advance` */
+typedef enum {
+    ELEVATOR_AT_FLOOR,      /* doors shut at `current_floor`, the next step decides where to go */
+    ELEVATOR_DOORS_OPEN,    /* people got off and nobody is going anywhere, back to AT_FLOOR when the doors shut */
+    ELEVATOR_BOARDING,      /* people got on or off, the car leaves in `direction` when the doors shut */
+    ELEVATOR_TRAVELLING     /* on the way to `next_floor` */
+} ElevatorPhase;
+
+#define ELEVATOR_WAIT -1        /* `elevator_advance` has nothing to do until `elevator_kick` */
+
+typedef struct ElevatorPolicy ElevatorPolicy;
+
+/**
+ * Distribution of a latency in log2 buckets of milliseconds: bucket 0 counts everything under 2ms, bucket i > 0 counts
+ * [2^i, 2^(i+1)) ms, and the last bucket also takes everything longer. Integer only, one `__fls` per sample.
+ */
+typedef struct {
+    u32 buckets[LATENCY_BUCKETS];
+    u32 count;
+    u64 total_ms;               /* for the mean */
+    u32 max_ms;
+} LatencyHistogram;
+
+void latency_histogram_add(LatencyHistogram *h, u64 ns);
+
+/* upper bound in ms of the bucket holding the `percent`th percentile, 0 if the histogram is empty */
+u32 latency_histogram_percentile(const LatencyHistogram *h, int percent);
+
+/**
+ * Wait (issue to board) and ride (board to alight) times of every passenger delivered since the last reset. Waits are
+ * kept by the floor the passenger waited on, rides by the floor they got off at.
+ */
+typedef struct {
+    LatencyHistogram wait_by_floor[MAX_NUM_FLOORS];
+    LatencyHistogram wait_by_type[NUM_PASSENGER_TYPES];
+    LatencyHistogram ride_by_floor[MAX_NUM_FLOORS];
+    LatencyHistogram ride_by_type[NUM_PASSENGER_TYPES];
+} ElevatorStats;
+
+typedef struct {
+    int id;                     /* index in `elevators` */
+    struct list_head queue;     /* queue of the passengers */
+    struct mutex lock;          /* lock to stop the elevator from being modified */
+    ElevatorState state;        /* enum of possible states */
+    ElevatorState direction;    /* save the direction for when state is LOADING */
+    int stopping;               /* set by `elevator_stop` until OFFLINE: board nobody, deliver the riders */
+    ElevatorPhase phase;        /* what the next `elevator_advance` finishes */
+    int waiting;                /* set while the car waits for `elevator_kick`, whoever clears it resumes the car */
+    u64 stop_ns;                /* building time of the last `elevator_stop` */
+    u64 drain_ns;               /* how long the last stop took to deliver everyone and go OFFLINE */
+    int current_floor;
+    int next_floor;
+    int total_serviced;
+    Load load;                  /* everyone in the car, `load.count` is the number of passengers */
+    const ElevatorPolicy *policy;   /* scheduling policy, swapped under `lock` */
+    int park_target;            /* floor the idle car is parked at or heading to, -1 when busy or not parking */
+    int park_decisions;         /* number of times an idle car picked a (new) floor to park at */
+    int park_hits;              /* idle periods that ended with a call from the parking floor */
+    int park_misses;            /* idle periods that ended with a call from anywhere else */
+    ElevatorStats stats;        /* latency histograms, updated as passengers board and alight */
+    DECLARE_BITMAP(calls, MAX_NUM_FLOORS);  /* bit `i` is set while the dispatcher has floor `i`'s call assigned here */
+    int overtakes;              /* passengers boarded past a queue head that didn't fit (relaxed FIFO) */
+} Elevator;
+
+/* whether an idle car parks at the predicted busiest floor when its policy doesn't pick a parking floor itself */
+extern int elevator_predictive_parking;
+
+/**
+ * Relaxed FIFO boarding, off by default since the spec mandates FIFO. With a window of N, when the head of the floor's
+ * queue going the car's way doesn't fit, up to N passengers behind them of types that do fit (earliest first) board
+ * past them per stop. A head that has waited `elevator_board_max_wait_ms` is never passed, so a
+ * bellhop can't be starved by a stream of children.
+ */
+extern int elevator_board_window;
+extern unsigned int elevator_board_max_wait_ms;
+
+/* global variable that holds the array of cars in the bank, they all serve the same `floors` */
+extern Elevator **elevators;
+extern int num_elevators;
+
+/* cars are vzalloc'd, their stats take ~60 KiB with MAX_NUM_FLOORS floors */
+Elevator* elevator_create(int id);
+void elevator_free(Elevator* elv);
+
+/* allocate the bank of `num` cars into `elevators` (`num` is clamped to 1..MAX_CARS), NULL if out of memory */
+Elevator **create_elevators_array(int num);
+void free_elevators_array(Elevator **elevators, int num);
+
+/**
+ * what /proc/elevator shows, copied out of the cars and floors as of their last `elevator_publish`. Loads are copied
+ * without the per-destination counters, so a publish doesn't copy a KiB per floor
+ */
+typedef struct {
+    int count;
+    int units;
+    int half_weight;
+    int by_type[NUM_PASSENGER_TYPES];
+} LoadSnapshot;
+
+typedef struct {
+    LoadSnapshot load;
+    int hall_waiting[NUM_HALL_DIRECTIONS];
+    int num_serviced;
+    int arrival_rate;
+    int car;
+} FloorSnapshot;
+
+typedef struct {
+    const char *policy;         /* name */
+    ElevatorState state;
+    int current_floor;
+    int next_floor;
+    int total_serviced;
+    LoadSnapshot load;
+    int park_target;
+    int park_decisions;
+    int park_hits;
+    int park_misses;
+    int num_calls;
+    int overtakes;
+    int stopping;               /* delivering its riders before going OFFLINE */
+    u32 drain_ms;               /* how long the last stop took */
+} CarSnapshot;
+
+typedef struct {
+    int num_cars;
+    CarSnapshot cars[MAX_CARS];
+    int num_floors;
+    FloorSnapshot floors[MAX_NUM_FLOORS];
+    long dispatched;            /* hall calls assigned by the dispatcher */
+    /* passenger cache counters, read when the snapshot is taken */
+    int passengers_live;
+    long passengers_allocated;
+    int passengers_failed;
+} ElevatorSnapshot;
+
+/**
+ * elevator_publish - refresh `elv`'s part of the snapshot and the floors, done by each car's thread on every state
+ * change, floor arrival and scheduling pass
+ * NOTE: caller should hold `elv` lock. The floor metrics are copied without their locks, so with several cars a
+ * floor's counters can be a few updates apart, each car republishes them at its next floor
+ */
+void elevator_publish(Elevator *elv);
+
+/* elevator_publish_policy - refresh just the policy name, for switching policies from any thread */
+void elevator_publish_policy(Elevator *elv);
+
+/* elevators_stats_copy - the sum of every car's `stats`, each copied under its lock (a few KiB) */
+void elevators_stats_copy(ElevatorStats *stats);
+
+/* elevators_stats_reset - clear every car's histograms */
+void elevators_stats_reset(void);
+
+/**
+ * elevator_snapshot - copy the last published snapshot into `snap` without taking any lock the elevator thread uses,
+ * retrying if the copy overlapped a publish
+ */
+void elevator_snapshot(ElevatorSnapshot *snap);
+
+/**
+ * returns whether the passenger `p` fits in the car on top of its current load
+ * NOTE: caller should hold `elv` lock
+ */
+int elevator_can_fit(Elevator *elv, PassengerNode *p);
+
+/**
+ * elevator_load_floor - board the passengers waiting at the car's floor that are going its way, in FIFO order, and
+ * past a head that doesn't fit as `elevator_board_window` allows. Takes the floor and car locks
+ * @return: the number of passengers that got on
+ */
+int elevator_load_floor(Elevator *elv);
+
+/**
+ * elevator_predict_park_floor - floor that minimises the expected distance to the next arrival, -1 if nothing has
+ * arrived recently. For one car that is the median of the floors weighted by their arrival rates, a bank of N cars
+ * spreads out over the (2i + 1) / 2N quantiles.
+ */
+int elevator_predict_park_floor(Elevator *elv);
+
+/**
+ * elevator_advance - run `elv` up to its next timed transition: arrive at a floor, let people off and on with the doors
+ * open, or leave, asking `elv->policy` where to go at every floor. The car never sleeps in here, the host calls this
+ * again once the returned time has passed (a timer in the module, the virtual clock in the simulator). Only one call
+ * per car may run at a time.
+ * @return: ms of building time until the next call, or ELEVATOR_WAIT to wait for `elevator_resume`
+ */
+int elevator_advance(Elevator *elv);
+
+/**
+ * elevator_start - set `elv` IDLE and have the host start advancing it
+ * @return: 1 if the car is not OFFLINE, 0 for a successful start
+ */
+int elevator_start(Elevator *elv);
+
+/**
+ * elevator_stop - stop `elv` at its next floor: from then on nobody boards, the riders are delivered by the shortest
+ * route, stopping only where somebody gets off, and the car goes OFFLINE (`drain_ns` records how long that took).
+ * Returns straight away, the car is no more than one floor away from noticing
+ * @return: 1 if the car is OFFLINE or already stopping, 0 otherwise
+ */
+int elevator_stop(Elevator *elv);
+
+/**
+ * elevator_kick - if `elv` is waiting for a call (or a stop), have the host resume it. Call after setting the call
+ */
+void elevator_kick(Elevator *elv);
+
+/**
+ * elevator_calls_copy - copy `elv->calls` into `calls` (MAX_NUM_FLOORS bits) without a lock, a word at a time, since the
+ * dispatcher and the cars set and clear bits in it concurrently
+ */
+void elevator_calls_copy(Elevator *elv, unsigned long *calls);
+
+/**
+ * elevator_eta - estimated ms until `elv` could open its doors at `floor_num`, finishing the work it already has
+ * in its current direction first. Reads the car without its lock, it's an estimate.
+ */
+int elevator_eta(Elevator *elv, int floor_num);
+
+/**
+ * elevator_dispatch - one pass of the dispatcher: drain the inboxes, update the arrival rates, and assign every floor in
+ * `floors_unassigned` that has someone waiting to the running car with the lowest `elevator_eta`, waking it
+ * NOTE: single consumer of the inboxes, only one dispatcher may run
+ * @return: the number of calls assigned
+ */
+int elevator_dispatch(void);
+
+/**
+ * elevator_issue_request - validate a request (1-indexed, as issued by the syscall) and queue the passenger
+ * @return: 1 if the request is not valid, 0 otherwise
+ */
+long elevator_issue_request(int passenger_type, int start_floor, int destination_floor);
+
+/* one request of a batch, same layout as `struct elevator_request` in the test programs' wrappers.h */
+typedef struct {
+    int passenger_type;
+    int start_floor;
+    int destination_floor;
+} ElevatorRequest;
+
+/* the chain heads `elevator_issue_requests` builds per start floor, too big for the stack, so the caller keeps one */
+typedef struct {
+    struct llist_node *first[MAX_NUM_FLOORS];
+    struct llist_node *last[MAX_NUM_FLOORS];
+} ElevatorRequestChains;
+
+/**
+ * elevator_issue_requests - `elevator_issue_request` for `count` requests at once (already copied from userspace)
+ * @chains: zeroed scratch space, left zeroed again, so one can serve every batch of a caller
+ * @return: the number of requests that were not valid
+ */
+long elevator_issue_requests(const ElevatorRequest *requests, int count, ElevatorRequestChains *chains);
+
+
+/**
+ ***********************************************************************************************************************
+ ********************************************** Scheduling Policies ****************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * A scheduling policy decides where a car goes; the core (`elevator_advance`) does the moving, loading and unloading.
+ * The floors a car has to answer are the hall calls the dispatcher assigned it (`calls`) plus its current floor.
+ * At every floor the core lets passengers off, asks `choose_direction` which way to go, boards the floor's queue in
+ * FIFO order for as long as the head passenger fits and is headed that way (the spec's boarding rule, so the direction
+ * is how a policy orders boarding), then moves one floor. A policy must only return a direction in which there is work
+ * (a destination in the car, a call, or the head of the current floor's queue), and IDLE only when nobody is in the
+ * car and it has no calls. Policies are called with no locks held.
+ */
+struct ElevatorPolicy {
+    const char *name;
+    /* UP or DOWN to board and move that way from the current floor, IDLE when there is nothing to do */
+    ElevatorState (*choose_direction)(Elevator *elv);
+    /* floor to wait at while IDLE, or -1 to stay where the car is, NULL leaves it to predictive parking */
+    int (*park_floor)(Elevator *elv);
+};
+
+/* NULL terminated, the first entry is the default */
+extern const ElevatorPolicy *ELEVATOR_POLICIES[];
+
+/**
+ * elevator_find_policy - the policy called `name`
+ * @return: the policy, or NULL if there is no such policy
+ */
+const ElevatorPolicy *elevator_find_policy(const char *name);
+
+/**
+ * elevator_set_policy - switch `elv` to the policy called `name`, takes effect at the next floor (every car of the bank
+ * has its own)
+ * @return: 0 on success, -1 if there is no such policy
+ */
+int elevator_set_policy(Elevator *elv, const char *name);
+
+
+/**
+ ***********************************************************************************************************************
+ ************************************************** Host Hooks *********************************************************
+ ***********************************************************************************************************************
+ */
+typedef enum {
+    ELEVATOR_EVENT_STATE,       /* `elv->state` changed */
+    ELEVATOR_EVENT_ARRIVE,      /* the car reached `elv->current_floor` (whether or not it stops there) */
+    ELEVATOR_EVENT_BOARD,       /* passenger left its floor queue and entered the car */
+    ELEVATOR_EVENT_ALIGHT       /* passenger reached its destination, called right before it is freed */
+} ElevatorEvent;
+
+/**
+ * elevator_notify - called by the core on car and passenger events, implemented by the host (module or simulator)
+ * `p` is the passenger for BOARD and ALIGHT, NULL otherwise
+ * NOTE: called with `elv` locked, so it must not sleep or take the elevator/floor locks
+ */
+void elevator_notify(Elevator *elv, ElevatorEvent event, PassengerNode *p);
+
+/**
+ * elevator_resume - have `elevator_advance(elv)` called again as soon as possible, implemented by the host. Called by
+ * `elevator_start` and by whoever ends an ELEVATOR_WAIT (see `elevator_kick`), never while a step is pending
+ * NOTE: may be called from the dispatcher or a syscall, with no locks held
+ */
+void elevator_resume(Elevator *elv);
+
+#endif /* __ELEVATOR_H */
@@ -0,0 +1,1296 @@
+#include "elevator.h"
+
+/**
+ * The elevator scheduler itself: passengers, floors, and the state machine that drives the car. Nothing in here depends
+ * on being a kernel module, see `elevator_platform.h` for how it also builds in userspace.
+ */
+
+
+/**
+ ***********************************************************************************************************************
+ ********************************************** Passenger Implementation ***********************************************
+ ***********************************************************************************************************************
+ */
+static const int PASSENGER_UNITS[NUM_PASSENGER_TYPES] = {1, 1, 2, 2};
+static const int PASSENGER_HALF_WEIGHTS[NUM_PASSENGER_TYPES] = {1, 2, 4, 6};   /* 0.5, 1, 2, 3 */
+const char *PASSENGER_TYPE_STRINGS[] = {"CHILD", "ADULT", "BELLHOP", "ROOM_SERVICE"};
+
+
+void load_add(Load *load, const PassengerNode *p)
+{
+    load->count++;
+    load->units += PASSENGER_UNITS[p->passenger_type];
+    load->half_weight += PASSENGER_HALF_WEIGHTS[p->passenger_type];
+    load->by_type[p->passenger_type]++;
+    load->by_dest[p->destination_floor]++;
+}
+
+void load_sub(Load *load, const PassengerNode *p)
+{
+    load->count--;
+    load->units -= PASSENGER_UNITS[p->passenger_type];
+    load->half_weight -= PASSENGER_HALF_WEIGHTS[p->passenger_type];
+    load->by_type[p->passenger_type]--;
+    load->by_dest[p->destination_floor]--;
+}
+
+int load_can_fit(const Load *load, const PassengerNode *p)
+{
+    return (load->units + PASSENGER_UNITS[p->passenger_type] <= MAX_LOAD_UNITS) &
+           (load->half_weight + PASSENGER_HALF_WEIGHTS[p->passenger_type] <= MAX_LOAD_HALF_WEIGHT);
+}
+
+
+/**
+ * every passenger comes from this cache rather than kmalloc: 1M queued passengers take 40 bytes each instead of a
+ * kmalloc-64 slot, and they don't fragment the general purpose caches. The counters are atomics because passengers are
+ * created by the syscalls and freed by the elevator thread
+ */
+static struct kmem_cache *passenger_cache;
+static atomic_t passengers_live;
+static atomic_long_t passengers_allocated;
+static atomic_t passengers_failed;
+
+int passenger_cache_create(void)
+{
+    passenger_cache = kmem_cache_create("elevator_passenger", sizeof(PassengerNode), 0, 0, NULL);
+    if (!passenger_cache) {
+        printk(KERN_WARNING "passenger_cache_create: failed to create slab cache\n");
+        return -1;
+    }
+    atomic_set(&passengers_live, 0);
+    atomic_long_set(&passengers_allocated, 0);
+    atomic_set(&passengers_failed, 0);
+    return 0;
+}
+
+/* NOTE: every passenger must have been freed already */
+void passenger_cache_destroy(void)
+{
+    kmem_cache_destroy(passenger_cache);
+    passenger_cache = NULL;
+}
+
+PassengerNode *passenger_node_create(PassengerType passenger_type, int destination_floor)
+{
+    PassengerNode *p = kmem_cache_zalloc(passenger_cache, GFP_KERNEL);
+    if (!p) {
+        atomic_inc(&passengers_failed);
+        printk("passenger_node_create: failed to allocate passenger\n");
+        return NULL;
+    }
+    atomic_inc(&passengers_live);
+    p->id = (u32) atomic_long_inc_return(&passengers_allocated);
+    p->passenger_type = passenger_type;
+    p->destination_floor = destination_floor;
+    p->issued_ns = elevator_now_ns();
+    return p;
+}
+
+void passenger_node_free(PassengerNode *p)
+{
+    atomic_dec(&passengers_live);
+    kmem_cache_free(passenger_cache, p);
+}
+
+/* bucket of a latency, see `LatencyHistogram` */
+static int latency_bucket(u32 ms)
+{
+    int bucket;
+    if (ms < 2)
+        return 0;
+    bucket = __fls(ms);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+void latency_histogram_add(LatencyHistogram *h, u64 ns)
+{
+    u64 ms64 = div_u64(ns, NSEC_PER_MSEC);
+    u32 ms = ms64 > U32_MAX ? U32_MAX : ms64;
+    h->buckets[latency_bucket(ms)]++;
+    h->count++;
+    h->total_ms += ms;
+    if (ms > h->max_ms)
+        h->max_ms = ms;
+}
+
+u32 latency_histogram_percentile(const LatencyHistogram *h, int percent)
+{
+    u64 rank, seen = 0;
+    int i;
+    if (h->count == 0)
+        return 0;
+    /* the smallest bucket that covers `percent` of the samples, rounded up so p100 is the max's bucket */
+    rank = div_u64((u64) h->count * percent + 99, 100);
+    for (i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank)
+            return (2U << i) - 1 < h->max_ms ? (2U << i) - 1 : h->max_ms;
+    }
+    return h->max_ms;
+}
+
+
+/**
+ ***********************************************************************************************************************
+ ******************************************** Building Configuration ***************************************************
+ ***********************************************************************************************************************
+ */
+int elevator_num_floors = 10;
+unsigned int elevator_travel_ms = 2000;
+unsigned int elevator_stop_ms = 2000;
+int elevator_max_load_units = 10;
+int elevator_max_load_weight = 15;
+unsigned int elevator_time_scale = 1;
+
+int elevator_config_check(void)
+{
+    int i;
+    if (elevator_num_floors < 2 || elevator_num_floors > MAX_NUM_FLOORS) {
+        printk(KERN_WARNING "elevator: %d floors, the building needs 2 to %d\n", elevator_num_floors, MAX_NUM_FLOORS);
+        return -1;
+    }
+    /* an empty car has to fit anybody, or whoever is at the head of a queue waits forever */
+    for (i = 0; i < NUM_PASSENGER_TYPES; i++) {
+        if (PASSENGER_UNITS[i] > MAX_LOAD_UNITS || PASSENGER_HALF_WEIGHTS[i] > MAX_LOAD_HALF_WEIGHT) {
+            printk(KERN_WARNING "elevator: a car of %d units and %d weight can't take a %s\n", MAX_LOAD_UNITS,
+                   MAX_LOAD_WEIGHT, PASSENGER_TYPE_STRINGS[i]);
+            return -1;
+        }
+    }
+    if (elevator_time_scale < 1) {
+        printk(KERN_WARNING "elevator: time scale must be at least 1\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* a u64 of ns wraps after ~584 years, so a 100x clock still lasts ~5 years of uptime */
+u64 elevator_now_ns(void)
+{
+    return ktime_get_ns() * elevator_time_scale;
+}
+
+
+/**
+ ***********************************************************************************************************************
+ *********************************************** Floor Implementation **************************************************
+ ***********************************************************************************************************************
+ */
+
+/* global variable that holds the array of `Floor`s */
+Floor **floors;
+DECLARE_BITMAP(floors_waiting, MAX_NUM_FLOORS);
+DECLARE_BITMAP(floors_unassigned, MAX_NUM_FLOORS);
+wait_queue_head_t floors_waitq;
+
+/* initalizes `Floor` struct with everything zero'd out */
+Floor *floor_create(int floor_num)
+{
+    Floor *floor = kcalloc(1, sizeof(Floor), GFP_KERNEL);
+    int hall, type;
+    if (!floor){
+        printk(KERN_WARNING "floor_create: failed to allocate space\n");
+        return NULL;
+    }
+    for (hall = 0; hall < NUM_HALL_DIRECTIONS; hall++) {
+        for (type = 0; type < NUM_PASSENGER_TYPES; type++)
+            INIT_LIST_HEAD(&floor->queues[hall][type]);
+    }
+    init_llist_head(&floor->inbox);
+    mutex_init(&floor->lock);
+    seqcount_init(&floor->seq);
+    floor->floor_num = floor_num;
+    floor->car = -1;
+    return floor;
+}
+
+/* deep free of the floors struct */
+void floor_free(Floor* floor)
+{
+    /* clear the floor queue and free the struct */
+    struct list_head *cur, *dummy;
+    PassengerNode *passenger_node, *tmp;
+    int hall, type;
+    /* free anything still sitting in the inbox */
+    llist_for_each_entry_safe(passenger_node, tmp, llist_del_all(&floor->inbox), inbox)
+        passenger_node_free(passenger_node);
+    /* free the linked list of passenger nodes from each of the floor queues */
+    mutex_lock(&floor->lock);
+    for (hall = 0; hall < NUM_HALL_DIRECTIONS; hall++) {
+        for (type = 0; type < NUM_PASSENGER_TYPES; type++) {
+            list_for_each_safe(cur, dummy, &floor->queues[hall][type]) {
+                passenger_node = list_entry(cur, PassengerNode, queue);
+                list_del(cur);
+                passenger_node_free(passenger_node);
+            }
+        }
+    }
+    mutex_unlock(&floor->lock);
+    kfree(floor);
+}
+
+/* dyanically allocate space for the global array holding all the floors */
+Floor** create_floors_array(int num_floors)
+{
+    int i;
+    Floor **floors = kcalloc(num_floors, sizeof(Floor*), GFP_KERNEL);
+    if (!floors){
+        printk(KERN_WARNING "create_floors_array: failed to allocate space\n");
+        return NULL;
+    }
+    for (i = 0; i < num_floors; i++) {
+        floors[i] = floor_create(i);
+        if (!floors[i]) {
+            /* nothing else can see the array yet, free the floors built so far */
+            while (i--)
+                floor_free(floors[i]);
+            kfree(floors);
+            return NULL;
+        }
+    }
+    bitmap_zero(floors_waiting, MAX_NUM_FLOORS);
+    bitmap_zero(floors_unassigned, MAX_NUM_FLOORS);
+    init_waitqueue_head(&floors_waitq);
+    return floors;
+}
+
+
+void free_floors_array(Floor** floors, int num_floors)
+{
+    int i;
+    for (i = 0; i < num_floors; i++) {
+        floor_free(floors[i]);
+    }
+    kfree(floors);
+}
+
+/**
+ * bracket a change to the metrics `elevator_publish` copies, so it never sees them half updated. Preemption is off in
+ * between, a publish spinning on the count can't wait on a writer that was scheduled out
+ * NOTE: caller should hold `floor` lock
+ */
+static void floor_write_begin(Floor *floor)
+{
+    preempt_disable();
+    write_seqcount_begin(&floor->seq);
+}
+
+static void floor_write_end(Floor *floor)
+{
+    write_seqcount_end(&floor->seq);
+    preempt_enable();
+}
+
+HallDirection floor_hall(Floor *floor, PassengerNode *p)
+{
+    return p->destination_floor > floor->floor_num ? HALL_UP : HALL_DOWN;
+}
+
+/**
+ * adds passenger to the end of the floor queue going their way, updating the floor load metrics
+ * NOTE: caller should hold `floor` lock
+ */
+static void __floor_enqueue_passenger(Floor *floor, PassengerNode *p)
+{
+    HallDirection hall = floor_hall(floor, p);
+    floor_write_begin(floor);
+    load_add(&floor->load, p);
+    floor->hall_waiting[hall]++;
+    floor->arrivals++;
+    floor_write_end(floor);
+    list_add_tail(&p->queue, &floor->queues[hall][p->passenger_type]);
+}
+
+void floor_enqueue_passenger(Floor* floor, PassengerNode* p)
+{
+    mutex_lock(&floor->lock);
+    __floor_enqueue_passenger(floor, p);
+    set_bit(floor->floor_num, floors_waiting);
+    set_bit(floor->floor_num, floors_unassigned);
+    mutex_unlock(&floor->lock);
+    wake_up_interruptible(&floors_waitq);
+}
+
+void floor_post_passenger(Floor *floor, PassengerNode *p)
+{
+    floor_post_batch(floor, &p->inbox, &p->inbox);
+}
+
+/* the bit goes up after the push, so whoever clears it can re-check the inbox (see `floor_dequeue_passenger`) */
+void floor_post_batch(Floor *floor, struct llist_node *first, struct llist_node *last)
+{
+    llist_add_batch(first, last, &floor->inbox);
+    set_bit(floor->floor_num, floors_waiting);
+    set_bit(floor->floor_num, floors_unassigned);
+    /* wq_has_sleeper has the barrier that pairs with the waiter, and skips the wait queue lock when nobody sleeps */
+    if (wq_has_sleeper(&floors_waitq))
+        wake_up_interruptible(&floors_waitq);
+}
+
+void floors_drain_inboxes(void)
+{
+    struct llist_node *batch;
+    PassengerNode *p, *tmp;
+    Floor *floor;
+    int i;
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        floor = floors[i];
+        if (llist_empty(&floor->inbox))
+            continue;
+        /* the inbox is a stack, reverse it to get the requests back in the order they were issued */
+        batch = llist_reverse_order(llist_del_all(&floor->inbox));
+        mutex_lock(&floor->lock);
+        llist_for_each_entry_safe(p, tmp, batch, inbox)
+            __floor_enqueue_passenger(floor, p);
+        mutex_unlock(&floor->lock);
+    }
+}
+
+/* whether `a` was issued before `b`, ids are handed out in issue order (and compared so they can wrap) */
+static int passenger_before(const PassengerNode *a, const PassengerNode *b)
+{
+    return (s32) (a->id - b->id) < 0;
+}
+
+/* the passenger of `type` going `hall` that has waited longest on `floor`, NULL if there is none */
+static PassengerNode *floor_type_head(Floor *floor, HallDirection hall, int type)
+{
+    if (list_empty(&floor->queues[hall][type]))
+        return NULL;
+    return list_first_entry(&floor->queues[hall][type], PassengerNode, queue);
+}
+
+PassengerNode *floor_hall_head(Floor *floor, HallDirection hall)
+{
+    PassengerNode *head = NULL, *p;
+    int type;
+    for (type = 0; type < NUM_PASSENGER_TYPES; type++) {
+        p = floor_type_head(floor, hall, type);
+        if (p && (!head || passenger_before(p, head)))
+            head = p;
+    }
+    return head;
+}
+
+PassengerNode *floor_head(Floor *floor)
+{
+    PassengerNode *up = floor_hall_head(floor, HALL_UP), *down = floor_hall_head(floor, HALL_DOWN);
+    if (!up || (down && passenger_before(down, up)))
+        return down;
+    return up;
+}
+
+/**
+ * remove passenger `p` from the floor queue, being sure to update load metrics. Once the queue is empty the floor's
+ * hall call is answered, whichever car it was assigned to
+ * NOTE: caller should hold `floor` lock
+ */
+PassengerNode* floor_dequeue_passenger(Floor *floor, PassengerNode *p)
+{
+    list_del(&p->queue);
+    floor_write_begin(floor);
+    load_sub(&floor->load, p);
+    floor->hall_waiting[floor_hall(floor, p)]--;
+    floor->num_serviced++;
+    if (floor->load.count == 0 && floor->car >= 0) {
+        clear_bit(floor->floor_num, elevators[floor->car]->calls);
+        floor->car = -1;
+    }
+    floor_write_end(floor);
+    if (floor->load.count == 0) {
+        /* a request may have been posted since the last drain, keep the bit for it */
+        clear_bit(floor->floor_num, floors_waiting);
+        smp_mb__after_atomic();
+        if (!llist_empty(&floor->inbox))
+            set_bit(floor->floor_num, floors_waiting);
+    }
+    return p;
+}
+
+/* print who is waiting on `floor` by type and by destination, from the counters rather than the queue */
+void floor_print(Floor* floor)
+{
+    int i;
+    if (floor->load.count == 0)
+        return;
+    mutex_lock(&floor->lock);
+    printk("Floor %d: %d waiting, types:", floor->floor_num, floor->load.count);
+    for (i = 0; i < NUM_PASSENGER_TYPES; i++)
+        printk(KERN_CONT " %d", floor->load.by_type[i]);
+    printk(KERN_CONT ", destinations:");
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++)
+        printk(KERN_CONT " %d", floor->load.by_dest[i]);
+    printk(KERN_CONT "\n");
+    mutex_unlock(&floor->lock);
+}
+
+
+void print_floors_array(Floor** floors, int num_floors)
+{
+    int i;
+    printk("Printing all floor queues\n");
+    for (i = 0; i < num_floors; i++)
+        floor_print(floors[i]);
+    printk("------------------------------------------------------------------\n");
+}
+
+/**
+ * rates are only updated from elevator_dispatch, so by the dispatcher thread (the sim's event loop), which runs it on
+ * every posted request and at least once an ARRIVAL_WINDOW while no requests come in. A window with no requests still
+ * decays the average, but a long idle stretch is capped at a few dozen windows since by then every rate is ~0
+ */
+void floors_update_arrival_rates(u64 now)
+{
+    static u64 last_window;
+    /* a window in ns is past 32 bits, too wide for div_u64 */
+    u64 window = div64_u64(now, (u64) ARRIVAL_WINDOW * NSEC_PER_SEC), elapsed;
+    Floor *floor;
+    int i, j, rate;
+    if (window <= last_window)
+        return;
+    elapsed = window - last_window;
+    last_window = window;
+    if (elapsed > 32)
+        elapsed = 32;
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        floor = floors[i];
+        mutex_lock(&floor->lock);
+        floor_write_begin(floor);
+        rate = floor->arrival_rate;
+        rate += ((floor->arrivals << ARRIVAL_RATE_SHIFT) - rate) >> ARRIVAL_EWMA_SHIFT;
+        floor->arrivals = 0;
+        /* the windows after that were empty, the arithmetic shift rounds down so the rate does reach 0 */
+        for (j = 1; j < elapsed; j++)
+            rate += (0 - rate) >> ARRIVAL_EWMA_SHIFT;
+        /* one store, the cars read it without the floor lock to pick where to park */
+        WRITE_ONCE(floor->arrival_rate, rate);
+        floor_write_end(floor);
+        mutex_unlock(&floor->lock);
+    }
+}
+
+/**
+ ***********************************************************************************************************************
+ ********************************************** Elevator Implementation ************************************************
+ ***********************************************************************************************************************
+ */
+const char *ELEVATOR_STATE_STRINGS[] = {"OFFLINE", "IDLE", "LOADING", "UP", "DOWN"};
+
+int elevator_predictive_parking = 1;
+int elevator_board_window = 0;
+unsigned int elevator_board_max_wait_ms = 60000;
+
+
+/* global variable that holds the array of cars */
+Elevator **elevators;
+int num_elevators;
+
+/* hall calls assigned by `elevator_dispatch`, only the dispatcher writes it */
+static long elevator_dispatched;
+
+
+/* return an allocated and initialized elevator, car `id` of the bank */
+Elevator* elevator_create(int id)
+{
+    Elevator * elv = vzalloc(sizeof(Elevator));
+    if (!elv) {
+        printk(KERN_WARNING "eleavtor_create: failed to allocate space\n");
+        return NULL;
+    }
+    elv->id = id;
+    elv->state = OFFLINE;
+    elv->policy = ELEVATOR_POLICIES[0];
+    elv->park_target = -1;
+    mutex_init(&elv->lock);
+    INIT_LIST_HEAD(&elv->queue);
+    elevator_publish(elv);
+    return elv;
+}
+
+
+Elevator **create_elevators_array(int num)
+{
+    Elevator **elvs;
+    int i;
+    if (num < 1)
+        num = 1;
+    if (num > MAX_CARS)
+        num = MAX_CARS;
+    elvs = kcalloc(num, sizeof(Elevator*), GFP_KERNEL);
+    if (!elvs) {
+        printk(KERN_WARNING "create_elevators_array: failed to allocate space\n");
+        return NULL;
+    }
+    for (i = 0; i < num; i++) {
+        elvs[i] = elevator_create(i);
+        if (!elvs[i]) {
+            free_elevators_array(elvs, i);
+            return NULL;
+        }
+    }
+    num_elevators = num;
+    elevator_dispatched = 0;
+    return elvs;
+}
+
+
+void free_elevators_array(Elevator **elvs, int num)
+{
+    int i;
+    for (i = 0; i < num; i++)
+        elevator_free(elvs[i]);
+    kfree(elvs);
+}
+
+
+/**
+ * the /proc snapshot: the car threads copy their own and the floor metrics in here under the write side of a seqlock,
+ * readers copy them out and retry if they overlapped a publish, so reading never blocks a car
+ */
+static ElevatorSnapshot elevator_snapshot_data;
+static DEFINE_SEQLOCK(elevator_snapshot_lock);
+
+static void load_snapshot(LoadSnapshot *snap, const Load *load)
+{
+    snap->count = load->count;
+    snap->units = load->units;
+    snap->half_weight = load->half_weight;
+    memcpy(snap->by_type, load->by_type, sizeof(snap->by_type));
+}
+
+/* copy the floor metrics without the floor lock, retrying if a change to them overlapped (see `floor_write_begin`) */
+static void floor_snapshot(FloorSnapshot *snap, Floor *floor)
+{
+    unsigned int seq;
+    do {
+        seq = read_seqcount_begin(&floor->seq);
+        load_snapshot(&snap->load, &floor->load);
+        snap->hall_waiting[HALL_UP] = floor->hall_waiting[HALL_UP];
+        snap->hall_waiting[HALL_DOWN] = floor->hall_waiting[HALL_DOWN];
+        snap->num_serviced = floor->num_serviced;
+        snap->arrival_rate = floor->arrival_rate;
+        snap->car = floor->car;
+    } while (read_seqcount_retry(&floor->seq, seq));
+}
+
+void elevator_publish(Elevator *elv)
+{
+    ElevatorSnapshot *snap = &elevator_snapshot_data;
+    CarSnapshot *car = &snap->cars[elv->id];
+    DECLARE_BITMAP(calls, MAX_NUM_FLOORS);
+    int i;
+    write_seqlock(&elevator_snapshot_lock);
+    if (snap->num_cars <= elv->id)
+        snap->num_cars = elv->id + 1;
+    car->policy = elv->policy->name;
+    car->state = elv->state;
+    car->current_floor = elv->current_floor;
+    car->next_floor = elv->next_floor;
+    car->total_serviced = elv->total_serviced;
+    load_snapshot(&car->load, &elv->load);
+    car->park_target = elv->park_target;
+    car->park_decisions = elv->park_decisions;
+    car->park_hits = elv->park_hits;
+    car->park_misses = elv->park_misses;
+    elevator_calls_copy(elv, calls);
+    car->num_calls = bitmap_weight(calls, NUM_FLOORS);
+    car->overtakes = elv->overtakes;
+    car->stopping = elv->stopping;
+    car->drain_ms = div_u64(elv->drain_ns, NSEC_PER_MSEC);
+    snap->num_floors = NUM_FLOORS;
+    for (i = MIN_FLOOR; floors && i <= MAX_FLOOR; i++)
+        floor_snapshot(&snap->floors[i], floors[i]);
+    snap->dispatched = READ_ONCE(elevator_dispatched);
+    write_sequnlock(&elevator_snapshot_lock);
+}
+
+void elevator_publish_policy(Elevator *elv)
+{
+    write_seqlock(&elevator_snapshot_lock);
+    elevator_snapshot_data.cars[elv->id].policy = elv->policy->name;
+    write_sequnlock(&elevator_snapshot_lock);
+}
+
+static void latency_histogram_merge(LatencyHistogram *into, const LatencyHistogram *h)
+{
+    int i;
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+        into->buckets[i] += h->buckets[i];
+    into->count += h->count;
+    into->total_ms += h->total_ms;
+    if (h->max_ms > into->max_ms)
+        into->max_ms = h->max_ms;
+}
+
+void elevators_stats_copy(ElevatorStats *stats)
+{
+    ElevatorStats *from;
+    int car, i;
+    memset(stats, 0, sizeof(ElevatorStats));
+    for (car = 0; car < num_elevators; car++) {
+        from = &elevators[car]->stats;
+        mutex_lock(&elevators[car]->lock);
+        for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+            latency_histogram_merge(&stats->wait_by_floor[i], &from->wait_by_floor[i]);
+            latency_histogram_merge(&stats->ride_by_floor[i], &from->ride_by_floor[i]);
+        }
+        for (i = 0; i < NUM_PASSENGER_TYPES; i++) {
+            latency_histogram_merge(&stats->wait_by_type[i], &from->wait_by_type[i]);
+            latency_histogram_merge(&stats->ride_by_type[i], &from->ride_by_type[i]);
+        }
+        mutex_unlock(&elevators[car]->lock);
+    }
+}
+
+void elevators_stats_reset(void)
+{
+    int car;
+    for (car = 0; car < num_elevators; car++) {
+        mutex_lock(&elevators[car]->lock);
+        memset(&elevators[car]->stats, 0, sizeof(ElevatorStats));
+        mutex_unlock(&elevators[car]->lock);
+    }
+}
+
+void elevator_snapshot(ElevatorSnapshot *snap)
+{
+    unsigned int seq;
+    do {
+        seq = read_seqbegin(&elevator_snapshot_lock);
+        *snap = elevator_snapshot_data;
+    } while (read_seqretry(&elevator_snapshot_lock, seq));
+    /* the cache counters are atomics, they don't need to be consistent with the rest */
+    snap->passengers_live = atomic_read(&passengers_live);
+    snap->passengers_allocated = atomic_long_read(&passengers_allocated);
+    snap->passengers_failed = atomic_read(&passengers_failed);
+}
+
+
+/**
+ * change the elevator's state, telling the host when it actually changes
+ * NOTE: caller should hold `elv` lock
+ */
+static void elevator_set_state(Elevator *elv, ElevatorState state)
+{
+    if (elv->state == state)
+        return;
+    WRITE_ONCE(elv->state, state);
+    elevator_notify(elv, ELEVATOR_EVENT_STATE, NULL);
+    elevator_publish(elv);
+}
+
+/**
+ * leave for the next floor in the elevator's current direction
+ * @return: ms until the car gets there
+ */
+static int elevator_depart(Elevator *elv)
+{
+    int delta = elv->direction == UP ? 1 : -1;
+    mutex_lock(&elv->lock);
+    elevator_set_state(elv, elv->direction);
+    elv->next_floor = elv->current_floor + delta;
+    elv->phase = ELEVATOR_TRAVELLING;
+    mutex_unlock(&elv->lock);
+    return TIME_BETWEEN_FLOORS;
+}
+
+/* the car reached `next_floor` */
+static void elevator_arrive(Elevator *elv)
+{
+    mutex_lock(&elv->lock);
+    WRITE_ONCE(elv->current_floor, elv->next_floor);
+    elv->phase = ELEVATOR_AT_FLOOR;
+    elevator_notify(elv, ELEVATOR_EVENT_ARRIVE, NULL);
+    elevator_publish(elv);
+    mutex_unlock(&elv->lock);
+}
+
+/**
+ * returns whether `p` fits in the car on top of its current load
+ * NOTE: caller should hold `elv` lock
+ */
+int elevator_can_fit(Elevator *elv, PassengerNode *p)
+{
+    return load_can_fit(&elv->load, p);
+}
+
+/**
+ * relaxed FIFO: `head` of the `hall` queue doesn't fit, so the earliest passenger behind them of a type that does
+ * (each type has its own queue, so that's one look per type) boards past them. Nobody boards past a head that has
+ * waited `elevator_board_max_wait_ms`, and at most `elevator_board_window` per stop
+ * NOTE: caller should hold locks to both `elv` and `floor`
+ * @return: the passenger to board instead, NULL to stop boarding here
+ */
+static PassengerNode *elevator_overtaker(Elevator *elv, Floor *floor, HallDirection hall, PassengerNode *head,
+                                         int overtaken)
+{
+    PassengerNode *p, *best = NULL;
+    int type;
+    if (overtaken >= elevator_board_window ||
+        elevator_now_ns() - head->issued_ns >= (u64) elevator_board_max_wait_ms * NSEC_PER_MSEC)
+        return NULL;
+    for (type = 0; type < NUM_PASSENGER_TYPES; type++) {
+        p = floor_type_head(floor, hall, type);
+        if (p && elevator_can_fit(elv, p) && (!best || passenger_before(p, best)))
+            best = p;
+    }
+    return best;
+}
+
+/**
+ *load a passenger into the elevator
+ * NOTE: caller should hold `elv` lock
+ */
+static void elevator_load_passenger(Elevator *elv, PassengerNode *p)
+{
+    if (!p)
+        return;
+    list_add_tail(&p->queue, &elv->queue);
+    p->boarded_ns = elevator_now_ns();
+    latency_histogram_add(&elv->stats.wait_by_floor[elv->current_floor], p->boarded_ns - p->issued_ns);
+    latency_histogram_add(&elv->stats.wait_by_type[p->passenger_type], p->boarded_ns - p->issued_ns);
+    elevator_notify(elv, ELEVATOR_EVENT_BOARD, p);
+    load_add(&elv->load, p);
+}
+
+
+
+/**
+ * picks up as many people moving in `elv->direction` as possible from the floor's queue going that way, in FIFO order
+ * (or relaxed FIFO with a `elevator_board_window`, see `elevator_overtaker`). People going the other way wait in the
+ * other queue, so they no longer hold up the ones behind them
+ * NOTE: spec mandates that the elevator must pick up people heading in the same direction
+ * @return: the number of passengers that boarded
+ */
+int elevator_load_floor(Elevator *elv)
+{
+    Floor *floor = floors[elv->current_floor];
+    HallDirection hall = elv->direction == UP ? HALL_UP : HALL_DOWN;
+    PassengerNode *p;
+    int boarded = 0, overtaken = 0;
+    mutex_lock(&floor->lock);
+    mutex_lock(&elv->lock);
+    while ((p = floor_hall_head(floor, hall))) {
+        if (!elevator_can_fit(elv, p)) {
+            p = elevator_overtaker(elv, floor, hall, p, overtaken);
+            if (!p)
+                break;
+            overtaken++;
+        }
+        elevator_load_passenger(elv, floor_dequeue_passenger(floor, p));
+        boarded++;
+    }
+    elv->overtakes += overtaken;
+    mutex_unlock(&elv->lock);
+    mutex_unlock(&floor->lock);
+    return boarded;
+}
+
+
+/**
+ *load a passenger into the elevator, updating load metrics
+ * NOTE: caller should hold `elv` lock
+ */
+static void elevator_unload_passenger(Elevator *elv, PassengerNode *p)
+{
+    u64 ride = elevator_now_ns() - p->boarded_ns;
+    list_del(&p->queue);
+    latency_histogram_add(&elv->stats.ride_by_floor[elv->current_floor], ride);
+    latency_histogram_add(&elv->stats.ride_by_type[p->passenger_type], ride);
+    elv->total_serviced++;
+    load_sub(&elv->load, p);
+    elevator_notify(elv, ELEVATOR_EVENT_ALIGHT, p);
+    passenger_node_free(p);
+}
+
+/**
+ * remove and free all passengers that are at their destination
+ * @return: the number of passengers that got off
+ */
+static int elevator_unload_floor(Elevator *elv)
+{
+    struct list_head *cur, *dummy;
+    PassengerNode *p;
+    int alighted = 0;
+    /* the common case, nobody is getting off here */
+    if (elv->load.by_dest[elv->current_floor] == 0)
+        return 0;
+    mutex_lock(&elv->lock);
+    /* remove passengers at their desitnation */
+    list_for_each_safe(cur, dummy, &elv->queue) {
+        p = list_entry(cur, PassengerNode, queue);
+        if (p->destination_floor == elv->current_floor) {
+            elevator_unload_passenger(elv, p);
+            alighted++;
+        }
+    }
+    mutex_unlock(&elv->lock);
+    return alighted;
+}
+
+
+/**
+ * open the doors for the mandatory time at the floor, `phase` says what happens once they shut
+ * @return: ms until they shut
+ */
+static int elevator_open_doors(Elevator *elv, ElevatorPhase phase)
+{
+    mutex_lock(&elv->lock);
+    elevator_set_state(elv, LOADING);
+    elv->phase = phase;
+    mutex_unlock(&elv->lock);
+    return TIME_AT_FLOOR;
+}
+
+
+/**
+ * the rate-weighted (2 * id + 1) / (2 * num_elevators) quantile floor, the median for a single car, see elevator.h.
+ * The rates are read without the floor locks: a window closing between the two passes only skews this one guess, and
+ * a sum that falls short of the total parks at the top
+ */
+int elevator_predict_park_floor(Elevator *elv)
+{
+    int i, total = 0, sum = 0;
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++)
+        total += READ_ONCE(floors[i]->arrival_rate);
+    if (total == 0)
+        return -1;
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        sum += READ_ONCE(floors[i]->arrival_rate);
+        if (2 * num_elevators * sum >= (2 * elv->id + 1) * total)
+            return i;
+    }
+    return MAX_FLOOR;
+}
+
+
+/**
+ * park until `elevator_kick`. The flag goes up before the calls are checked again and the kicker sets the call before
+ * it looks at the flag, so one of the two always sees the other
+ * @return: ELEVATOR_WAIT, or 0 to go again right away if a call or a stop came in meanwhile
+ */
+static int elevator_wait(Elevator *elv)
+{
+    WRITE_ONCE(elv->waiting, 1);
+    smp_mb();
+    if ((!bitmap_empty(elv->calls, NUM_FLOORS) || READ_ONCE(elv->stopping)) && xchg(&elv->waiting, 0))
+        return 0;
+    return ELEVATOR_WAIT;
+}
+
+/**
+ * nothing to do: go OFFLINE if the car is stopping, else drift one floor towards the parking floor (the policy's, or
+ * else the predicted one), or once parked wait until the dispatcher assigns us a call or we are told to stop
+ * @return: ms until the next step, or ELEVATOR_WAIT
+ */
+static int elevator_idle(Elevator *elv)
+{
+    int park = -1;
+    if (READ_ONCE(elv->stopping)) {
+        mutex_lock(&elv->lock);
+        elv->drain_ns = elevator_now_ns() - elv->stop_ns;
+        WRITE_ONCE(elv->stopping, 0);
+        elevator_set_state(elv, OFFLINE);
+        mutex_unlock(&elv->lock);
+        return ELEVATOR_WAIT;
+    }
+    if (elv->policy->park_floor)
+        park = elv->policy->park_floor(elv);
+    else if (elevator_predictive_parking)
+        park = elevator_predict_park_floor(elv);
+    if (park >= MIN_FLOOR && park <= MAX_FLOOR && park != elv->park_target) {
+        mutex_lock(&elv->lock);
+        elv->park_target = park;
+        elv->park_decisions++;
+        mutex_unlock(&elv->lock);
+    }
+    if (park >= MIN_FLOOR && park <= MAX_FLOOR && park != elv->current_floor) {
+        elv->direction = park > elv->current_floor ? UP : DOWN;
+        return elevator_depart(elv);
+    }
+    mutex_lock(&elv->lock);
+    elevator_set_state(elv, IDLE);
+    mutex_unlock(&elv->lock);
+    return elevator_wait(elv);
+}
+
+
+/* a call ended the idle period, score the parking decision by whether it came from the parking floor */
+static void elevator_end_parking(Elevator *elv)
+{
+    mutex_lock(&elv->lock);
+    if (test_bit(elv->park_target, floors_waiting))
+        elv->park_hits++;
+    else
+        elv->park_misses++;
+    elv->park_target = -1;
+    mutex_unlock(&elv->lock);
+}
+
+
+/**
+ * the car is leaving its floor: if it had the floor's hall call and left people behind (they were going the other way
+ * or didn't fit), hand the call back to the dispatcher, which may give it to a car that gets there sooner
+ */
+static void elevator_release_call(Elevator *elv)
+{
+    Floor *floor = floors[elv->current_floor];
+    int reassign = 0;
+    if (!test_bit(elv->current_floor, elv->calls))
+        return;
+    mutex_lock(&floor->lock);
+    if (floor->car == elv->id) {
+        clear_bit(elv->current_floor, elv->calls);
+        floor_write_begin(floor);
+        floor->car = -1;
+        floor_write_end(floor);
+        if (floor->load.count > 0) {
+            set_bit(elv->current_floor, floors_unassigned);
+            reassign = 1;
+        }
+    }
+    mutex_unlock(&floor->lock);
+    if (reassign)
+        wake_up_interruptible(&floors_waitq);
+}
+
+
+/**
+ * while stopping: the shortest route past every destination still in the car. With destinations on both sides that is
+ * to the nearer end first and then the far one (ties keep the car's direction); the stops are the same either way,
+ * since the car only stops where somebody gets off. IDLE once the car is empty
+ */
+static ElevatorState elevator_unload_direction(Elevator *elv)
+{
+    int i, lowest = -1, highest = -1, below, above;
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        if (!elv->load.by_dest[i])
+            continue;
+        if (lowest < 0)
+            lowest = i;
+        highest = i;
+    }
+    if (lowest < 0)
+        return IDLE;
+    below = elv->current_floor - lowest;
+    above = highest - elv->current_floor;
+    if (below <= 0)
+        return UP;
+    if (above <= 0)
+        return DOWN;
+    if (below != above)
+        return below < above ? DOWN : UP;
+    return elv->direction == DOWN ? DOWN : UP;
+}
+
+/**
+ * the car is at a floor with the doors shut: let people off, ask the policy (or, once stopping, the riders) which way
+ * to go, board that way and leave. The car only stops (TIME_AT_FLOOR) at floors where somebody gets on or off
+ * @return: ms until the next step, or ELEVATOR_WAIT
+ */
+static int elevator_at_floor(Elevator *elv)
+{
+    ElevatorState direction;
+    int alighted, boarded = 0, stopping = READ_ONCE(elv->stopping);
+    alighted = elevator_unload_floor(elv);
+    /* new calls and alightings */
+    mutex_lock(&elv->lock);
+    elevator_publish(elv);
+    mutex_unlock(&elv->lock);
+    direction = stopping ? elevator_unload_direction(elv) : elv->policy->choose_direction(elv);
+    if (direction != UP && direction != DOWN) {
+        if (alighted)
+            return elevator_open_doors(elv, ELEVATOR_DOORS_OPEN);
+        return elevator_idle(elv);
+    }
+    if (elv->park_target >= 0)
+        elevator_end_parking(elv);
+    /* the direction we leave in decides who may board, so set it before loading */
+    WRITE_ONCE(elv->direction, direction);
+    if (!stopping)
+        boarded = elevator_load_floor(elv);
+    if (alighted || boarded)
+        return elevator_open_doors(elv, ELEVATOR_BOARDING);
+    elevator_release_call(elv);
+    return elevator_depart(elv);
+}
+
+int elevator_advance(Elevator *elv)
+{
+    switch (elv->phase) {
+    case ELEVATOR_TRAVELLING:
+        elevator_arrive(elv);
+        break;
+    case ELEVATOR_BOARDING:
+        elevator_release_call(elv);
+        return elevator_depart(elv);
+    default:
+        break;
+    }
+    return elevator_at_floor(elv);
+}
+
+
+/* the furthest floor `elv` has work on (a destination or a call) in `direction`, or its current floor */
+static int elevator_turning_floor(Elevator *elv, ElevatorState direction, const unsigned long *work)
+{
+    int cur = READ_ONCE(elv->current_floor), furthest;
+    if (direction == UP) {
+        furthest = find_last_bit(work, NUM_FLOORS);
+        return furthest < NUM_FLOORS && furthest > cur ? furthest : cur;
+    }
+    furthest = find_first_bit(work, NUM_FLOORS);
+    return furthest < cur ? furthest : cur;
+}
+
+/* number of floors in `work` strictly between `from` and `to` */
+static int elevator_stops_between(const unsigned long *work, int from, int to)
+{
+    int lo = from < to ? from : to, hi = from < to ? to : from, stops = 0, i;
+    for (i = lo + 1; i < hi; i++)
+        stops += test_bit(i, work);
+    return stops;
+}
+
+/**
+ * a car that is idle goes straight there. A moving car that will pass `floor_num` on its way gets there after the
+ * stops in between, otherwise it first finishes its sweep to the furthest destination or call and turns around
+ */
+int elevator_eta(Elevator *elv, int floor_num)
+{
+    ElevatorState state = READ_ONCE(elv->state), direction = READ_ONCE(elv->direction);
+    int cur = READ_ONCE(elv->current_floor), turn, travel, stops, i;
+    DECLARE_BITMAP(work, MAX_NUM_FLOORS);
+    elevator_calls_copy(elv, work);
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        if (READ_ONCE(elv->load.by_dest[i]))
+            set_bit(i, work);
+    }
+    if (state == IDLE || bitmap_empty(work, NUM_FLOORS) || (direction != UP && direction != DOWN)) {
+        travel = abs(floor_num - cur);
+        stops = 0;
+    }
+    else if (direction == UP ? floor_num >= cur : floor_num <= cur) {
+        travel = abs(floor_num - cur);
+        stops = elevator_stops_between(work, cur, floor_num);
+    }
+    else {
+        turn = elevator_turning_floor(elv, direction, work);
+        travel = abs(turn - cur) + abs(turn - floor_num);
+        stops = elevator_stops_between(work, cur, turn) + (turn != cur) + elevator_stops_between(work, turn, floor_num);
+    }
+    return travel * TIME_BETWEEN_FLOORS + stops * TIME_AT_FLOOR;
+}
+
+
+/* the running car that can get to `floor_num` first, -1 if none is running */
+static int elevator_pick_car(int floor_num)
+{
+    int car, eta, best = -1, best_eta = 0;
+    for (car = 0; car < num_elevators; car++) {
+        if (READ_ONCE(elevators[car]->state) == OFFLINE || READ_ONCE(elevators[car]->stopping))
+            continue;
+        eta = elevator_eta(elevators[car], floor_num);
+        if (best < 0 || eta < best_eta) {
+            best = car;
+            best_eta = eta;
+        }
+    }
+    return best;
+}
+
+int elevator_dispatch(void)
+{
+    DECLARE_BITMAP(pending, MAX_NUM_FLOORS);
+    unsigned long woken = 0;
+    Floor *floor;
+    int i, car, assigned = 0;
+    floors_drain_inboxes();
+    floors_update_arrival_rates(elevator_now_ns());
+    /* the bitmap is what wakes us, but a call nobody could take (no car was running) is still owed one */
+    for (i = 0; i < BITS_TO_LONGS(NUM_FLOORS); i++)
+        pending[i] = xchg(&floors_unassigned[i], 0) | READ_ONCE(floors_waiting[i]);
+    for_each_set_bit(i, pending, NUM_FLOORS) {
+        floor = floors[i];
+        if (READ_ONCE(floor->car) >= 0)
+            continue;
+        mutex_lock(&floor->lock);
+        if (floor->car < 0 && floor->load.count > 0) {
+            car = elevator_pick_car(i);
+            if (car >= 0) {
+                floor_write_begin(floor);
+                floor->car = car;
+                floor_write_end(floor);
+                set_bit(i, elevators[car]->calls);
+                woken |= 1UL << car;
+                assigned++;
+            }
+        }
+        mutex_unlock(&floor->lock);
+    }
+    WRITE_ONCE(elevator_dispatched, elevator_dispatched + assigned);
+    while (woken) {
+        car = __ffs(woken);
+        woken &= woken - 1;
+        elevator_kick(elevators[car]);
+    }
+    return assigned;
+}
+
+
+
+/**
+ * free the elevator `elv`, making sure to free all passengers in its queue
+ * NOTE: by the time this is called, the elevator should have unloaded all passengers
+ */
+void elevator_free(Elevator* elv)
+{
+    /* at time of elevator_free, the elevator should be void of passengers
+       but clear just in case
+     */
+    struct list_head *cur, *dummy;
+    PassengerNode *passenger_node;
+    /* free the linked list of passenger nodes from the elevator */
+    list_for_each_safe(cur, dummy, &elv->queue) {
+        passenger_node = list_entry(cur, PassengerNode, queue);
+        list_del(cur);
+        passenger_node_free(passenger_node);
+    }
+    vfree(elv);
+}
+
+
+void elevator_calls_copy(Elevator *elv, unsigned long *calls)
+{
+    int i;
+    for (i = 0; i < BITS_TO_LONGS(NUM_FLOORS); i++)
+        calls[i] = READ_ONCE(elv->calls[i]);
+}
+
+
+void elevator_kick(Elevator *elv)
+{
+    /* pairs with the barrier in `elevator_wait`: whatever the caller changed is visible before the flag is read */
+    smp_mb();
+    if (READ_ONCE(elv->waiting) && xchg(&elv->waiting, 0))
+        elevator_resume(elv);
+}
+
+
+int elevator_start(Elevator *elv)
+{
+    mutex_lock(&elv->lock);
+    if (elv->state != OFFLINE) {
+        mutex_unlock(&elv->lock);
+        return 1;
+    }
+    elv->stopping = 0;
+    elv->waiting = 0;
+    elv->phase = ELEVATOR_AT_FLOOR;
+    elevator_set_state(elv, IDLE);
+    mutex_unlock(&elv->lock);
+    elevator_resume(elv);
+    return 0;
+}
+
+
+int elevator_stop(Elevator *elv)
+{
+    mutex_lock(&elv->lock);
+    if (elv->state == OFFLINE || elv->stopping) {
+        mutex_unlock(&elv->lock);
+        return 1;
+    }
+    elv->stop_ns = elevator_now_ns();
+    WRITE_ONCE(elv->stopping, 1);
+    elevator_publish(elv);
+    mutex_unlock(&elv->lock);
+    elevator_kick(elv);
+    return 0;
+}
+
+
+/* a request that was served where it was issued, from any number of producers at once */
+static void floor_count_serviced(Floor *floor)
+{
+    mutex_lock(&floor->lock);
+    floor_write_begin(floor);
+    floor->num_serviced++;
+    floor_write_end(floor);
+    mutex_unlock(&floor->lock);
+}
+
+/**
+ * validate a request (1-indexed, as issued by the syscalls) and create its passenger, 0-indexing `*start_floor`
+ * @return: 1 if the request is not valid, 0 otherwise, with `*p` NULL if nobody needs to be queued
+ */
+static long elevator_prepare_request(int passenger_type, int *start_floor, int destination_floor, PassengerNode **p)
+{
+    *p = NULL;
+    passenger_type--; (*start_floor)--; destination_floor--; /* requests are issued using 1-indexed vals */
+    if ((*start_floor < MIN_FLOOR || *start_floor > MAX_FLOOR) ||
+        (destination_floor < MIN_FLOOR || destination_floor > MAX_FLOOR)) {
+        printk("issue_request: invalid floor value(s), start: %d, end: %d\n", *start_floor, destination_floor);
+        return 1;
+    }
+    else if ((passenger_type < 0 || passenger_type >= NUM_PASSENGER_TYPES)) {
+        printk("issue_request: invalid passenger type: %d\n", passenger_type);
+        return 1;
+    }
+    else if (*start_floor == destination_floor) {
+        /* don't even bother enqueueing if the passenger doesn't need to go anywhere */
+        floor_count_serviced(floors[*start_floor]);
+    }
+    else {
+        *p = passenger_node_create(passenger_type, destination_floor);
+        if (!*p)
+            return 1;
+    }
+    return 0;
+}
+
+
+/* validate and queue a request, the syscall passes its 1-indexed arguments straight through */
+long elevator_issue_request(int passenger_type, int start_floor, int destination_floor)
+{
+    PassengerNode *p;
+    if (elevator_prepare_request(passenger_type, &start_floor, destination_floor, &p))
+        return 1;
+    if (p)
+        floor_post_passenger(floors[start_floor], p);
+    return 0;
+}
+
+
+/**
+ * the passengers are chained per start floor first (newest first, like an inbox), so each floor's inbox takes one
+ * atomic push per batch instead of one per passenger
+ */
+long elevator_issue_requests(const ElevatorRequest *requests, int count, ElevatorRequestChains *chains)
+{
+    struct llist_node **first = chains->first, **last = chains->last;
+    PassengerNode *p;
+    long invalid = 0;
+    int i, start_floor;
+    for (i = 0; i < count; i++) {
+        start_floor = requests[i].start_floor;
+        if (elevator_prepare_request(requests[i].passenger_type, &start_floor, requests[i].destination_floor, &p)) {
+            invalid++;
+            continue;
+        }
+        if (!p)
+            continue;
+        if (!first[start_floor])
+            last[start_floor] = &p->inbox;
+        p->inbox.next = first[start_floor];
+        first[start_floor] = &p->inbox;
+    }
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        if (first[i]) {
+            floor_post_batch(floors[i], first[i], last[i]);
+            first[i] = NULL;
+        }
+    }
+    return invalid;
+}
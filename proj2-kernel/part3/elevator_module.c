@@ -0,0 +1,808 @@
+#include <linux/hrtimer.h>  /* the per car timers */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kfifo.h>    /* per reader event queues */
+#include <linux/kthread.h>  /* kthread_run, kthread_stop */
+#include <linux/miscdevice.h>   /* misc_register, /dev/elevator_events */
+#include <linux/module.h>   /* module_init, module_exit */
+#include <linux/linkage.h>
+#include <linux/poll.h>     /* poll_wait */
+#include <linux/uaccess.h>
+#include <linux/slab.h>     /* kmalloc, kfree */
+#include <linux/spinlock.h> /* protects the list of event readers */
+#include <linux/proc_fs.h>  /* proc_create, fops */
+#include <linux/seq_file.h> /* single_open, seq_printf */
+#include <linux/string.h>   /* strim */
+#include <linux/vmalloc.h>  /* vmalloc, vfree */
+#include <linux/workqueue.h>    /* the car steps run as work items */
+#include "elevator.h"
+
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Module implementing an elevator");
+
+/* scheduling policy at load time, can be changed later by writing its name to /proc/elevator */
+static char *policy = "scan";
+module_param(policy, charp, 0444);
+MODULE_PARM_DESC(policy, "scheduling policy: scan (default), look, ssf or lobby");
+
+/* number of cars in the bank, they share the floors and a dispatcher assigns them the hall calls */
+static int cars = 1;
+module_param(cars, int, 0444);
+MODULE_PARM_DESC(cars, "number of cars, 1 (default) to 8");
+
+/* the building, these live in the core and are fixed once the floors and cars are created, see elevator.h */
+module_param_named(floors, elevator_num_floors, int, 0444);
+MODULE_PARM_DESC(floors, "number of floors, 10 (default) to 256");
+module_param_named(travel_ms, elevator_travel_ms, uint, 0444);
+MODULE_PARM_DESC(travel_ms, "ms to move between two floors (default 2000)");
+module_param_named(stop_ms, elevator_stop_ms, uint, 0444);
+MODULE_PARM_DESC(stop_ms, "ms the doors stay open at a stop (default 2000)");
+module_param_named(max_units, elevator_max_load_units, int, 0444);
+MODULE_PARM_DESC(max_units, "most units a car holds (default 10)");
+module_param_named(max_weight, elevator_max_load_weight, int, 0444);
+MODULE_PARM_DESC(max_weight, "most weight a car holds (default 15)");
+module_param_named(time_scale, elevator_time_scale, uint, 0444);
+MODULE_PARM_DESC(time_scale, "run building time this many times faster than real time, e.g. 100 for benchmarks "
+                 "(default 1)");
+
+/* lives in the core, can be flipped at runtime through /sys/module/elevator/parameters/park */
+module_param_named(park, elevator_predictive_parking, int, 0644);
+MODULE_PARM_DESC(park, "park the idle car at the floor with the most expected arrivals (default 1)");
+
+/* relaxed FIFO boarding, also in the core and adjustable at runtime, see elevator.h */
+module_param_named(board_window, elevator_board_window, int, 0644);
+MODULE_PARM_DESC(board_window, "passengers that may board past a queue head that doesn't fit, per stop "
+                 "(default 0, strict FIFO)");
+module_param_named(board_max_wait_ms, elevator_board_max_wait_ms, uint, 0644);
+MODULE_PARM_DESC(board_max_wait_ms, "never board past a head that has waited this long (default 60000)");
+
+/* variables to handle procfs output */
+#define PROC_NAME "elevator"
+#define PROC_PERMS 0644
+#define PROC_PARENT_DIR NULL
+#define STATS_PROC_NAME "elevator_stats"
+#define POLICY_NAME_SIZE 16     /* longest policy name that can be written to the proc file */
+#define ISSUE_BATCH_SIZE 256    /* requests copied from userspace at a time by `issue_requests` */
+#define EVENTS_NAME "elevator_events"   /* /dev/elevator_events */
+#define EVENTS_FIFO_SIZE 1024   /* records buffered per reader (power of 2), later ones are dropped until it reads */
+
+
+/**
+ ***********************************************************************************************************************
+ ************************************************ Elevator Threads *****************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * Each car is a state machine (`elevator_advance`) rather than a thread: a step runs as a work item, since it takes
+ * the elevator and floor mutexes, and re-arms the car's hrtimer for the time it returned. When the timer fires it
+ * queues the next step. A car waiting for a call has neither pending until `elevator_resume` queues its work.
+ */
+typedef struct {
+    Elevator *elv;
+    struct hrtimer timer;       /* fires when the current floor transition is over */
+    struct work_struct work;    /* runs the next `elevator_advance` */
+} CarDriver;
+
+static CarDriver car_drivers[MAX_CARS];
+static struct workqueue_struct *elevator_wq;    /* unbound, the cars don't share a CPU */
+static int cars_shutdown;                       /* set on module exit so the timers and work stop re-arming */
+static struct task_struct *dispatcher_kthread;  /* the thread assigning hall calls to the cars (`bank_lock`) */
+static DEFINE_MUTEX(bank_lock);                 /* serialises start_elevator and stop_elevator, outermost lock */
+
+static void events_emit(Elevator *elv, ElevatorEvent event, PassengerNode *p);
+
+
+/* every car and passenger event goes to the readers of /dev/elevator_events */
+void elevator_notify(Elevator *elv, ElevatorEvent event, PassengerNode *p)
+{
+    events_emit(elv, event, p);
+}
+
+
+void elevator_resume(Elevator *elv)
+{
+    if (!READ_ONCE(cars_shutdown))
+        queue_work(elevator_wq, &car_drivers[elv->id].work);
+}
+
+
+/* one step of the car, then sleep on the timer for as much building time as it takes */
+static void car_work(struct work_struct *work)
+{
+    CarDriver *driver = container_of(work, CarDriver, work);
+    int ms = elevator_advance(driver->elv);
+    if (ms == ELEVATOR_WAIT || READ_ONCE(cars_shutdown))
+        return;
+    hrtimer_start(&driver->timer, ns_to_ktime((u64) ms * NSEC_PER_MSEC / elevator_time_scale), HRTIMER_MODE_REL);
+}
+
+/* timers run in interrupt context and a step sleeps on mutexes, so hand it over to the workqueue */
+static enum hrtimer_restart car_timer(struct hrtimer *timer)
+{
+    CarDriver *driver = container_of(timer, CarDriver, timer);
+    if (!READ_ONCE(cars_shutdown))
+        queue_work(elevator_wq, &driver->work);
+    return HRTIMER_NORESTART;
+}
+
+static int car_drivers_create(void)
+{
+    int i;
+    elevator_wq = alloc_workqueue("elevator", WQ_UNBOUND, MAX_CARS);
+    if (!elevator_wq)
+        return -ENOMEM;
+    for (i = 0; i < num_elevators; i++) {
+        car_drivers[i].elv = elevators[i];
+        hrtimer_init(&car_drivers[i].timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        car_drivers[i].timer.function = car_timer;
+        INIT_WORK(&car_drivers[i].work, car_work);
+    }
+    return 0;
+}
+
+/* once the flag is up neither re-arms the other, so cancelling the timer and then the work leaves nothing pending */
+static void car_drivers_destroy(void)
+{
+    int i;
+    if (!elevator_wq)
+        return;
+    WRITE_ONCE(cars_shutdown, 1);
+    for (i = 0; i < num_elevators; i++) {
+        hrtimer_cancel(&car_drivers[i].timer);
+        cancel_work_sync(&car_drivers[i].work);
+        hrtimer_cancel(&car_drivers[i].timer);
+    }
+    destroy_workqueue(elevator_wq);
+    elevator_wq = NULL;
+}
+
+
+/**
+ * the dispatcher: assign hall calls whenever a request is posted or a car leaves people behind. The timeout keeps the
+ * arrival rates (which it updates) decaying while no requests come in
+ */
+static int dispatcher_run(void *data)
+{
+    while (!kthread_should_stop()) {
+        elevator_dispatch();
+        wait_event_interruptible_timeout(floors_waitq,
+                                         !bitmap_empty(floors_unassigned, NUM_FLOORS) || kthread_should_stop(),
+                                         msecs_to_jiffies(ARRIVAL_WINDOW * MSEC_PER_SEC / elevator_time_scale));
+    }
+    return 0;
+}
+
+
+/**
+ * start every car, then the dispatcher (which assigns the calls that queued up while the bank was offline)
+ * @return: 1 if the bank is already active, 0 for a successful start, or an error once the cars it started are stopped
+ */
+static int elevators_start(void)
+{
+    int i, ret = 0;
+    mutex_lock(&bank_lock);
+    for (i = 0; i < num_elevators; i++) {
+        if (READ_ONCE(elevators[i]->state) != OFFLINE) {
+            ret = 1;
+            goto out;
+        }
+    }
+    for (i = 0; i < num_elevators; i++) {
+        ret = elevator_start(elevators[i]);
+        if (ret)
+            goto err_cars;
+    }
+    dispatcher_kthread = kthread_run(dispatcher_run, NULL, "elevator_dispatch");
+    if (IS_ERR(dispatcher_kthread)) {
+        printk("ERROR: kthread_run(dispatcher_run, ...)\n");
+        ret = PTR_ERR(dispatcher_kthread);
+        dispatcher_kthread = NULL;
+        goto err_cars;
+    }
+    mutex_unlock(&bank_lock);
+    return 0;
+
+err_cars:
+    /* the cars started so far go back OFFLINE, so a later start_elevator can try again */
+    while (i--)
+        elevator_stop(elevators[i]);
+out:
+    mutex_unlock(&bank_lock);
+    return ret;
+}
+
+/**
+ * stop the dispatcher so no more calls are assigned, then every car. Returns once they have been told, each car goes
+ * OFFLINE by itself after delivering its riders
+ */
+static int elevators_stop(void)
+{
+    int i;
+    mutex_lock(&bank_lock);
+    if (IS_ERR_OR_NULL(dispatcher_kthread)) {
+        mutex_unlock(&bank_lock);
+        return 1;
+    }
+    kthread_stop(dispatcher_kthread);
+    dispatcher_kthread = NULL;
+    for (i = 0; i < num_elevators; i++)
+        elevator_stop(elevators[i]);
+    mutex_unlock(&bank_lock);
+    return 0;
+}
+
+
+
+/**
+ ***********************************************************************************************************************
+ *********************************************** Syscall Functions *****************************************************
+ ***********************************************************************************************************************
+ */
+
+/* STUB pointers (were exported in the wrappers) that "register" the sys call functions */
+extern long (*STUB_start_elevator) (void);
+extern long (*STUB_issue_request) (int, int, int);
+extern long (*STUB_issue_requests) (const void __user *, unsigned int);
+extern long (*STUB_stop_elevator) (void);
+
+
+/* Implementation of the system calls, the STUB pointers will point to these functions */
+long start_elevator(void)
+{
+    printk(KERN_INFO "starting the elevator service with %d car(s)\n", num_elevators);
+    return elevators_start();
+}
+
+
+long issue_request(int passenger_type, int start_floor, int destination_floor)
+{
+    return elevator_issue_request(passenger_type, start_floor, destination_floor);
+}
+
+
+/**
+ * issue `count` requests (an array of `ElevatorRequest`) in one syscall, copied in and queued ISSUE_BATCH_SIZE at a time
+ * @return: the number of invalid requests, or -EFAULT / -ENOMEM
+ */
+long issue_requests(const void __user *requests, unsigned int count)
+{
+    const ElevatorRequest __user *user_requests = requests;
+    /* the copied requests and the core's chain heads, allocated once for all the batches of the call */
+    struct {
+        ElevatorRequest requests[ISSUE_BATCH_SIZE];
+        ElevatorRequestChains chains;
+    } *batch;
+    unsigned int done, n;
+    long invalid = 0;
+    batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+    if (!batch)
+        return -ENOMEM;
+    for (done = 0; done < count; done += n) {
+        n = min_t(unsigned int, count - done, ISSUE_BATCH_SIZE);
+        if (copy_from_user(batch->requests, user_requests + done, n * sizeof(ElevatorRequest))) {
+            kfree(batch);
+            return -EFAULT;
+        }
+        invalid += elevator_issue_requests(batch->requests, n, &batch->chains);
+        cond_resched(); /* a million requests is a while to hold the CPU */
+    }
+    kfree(batch);
+    return invalid;
+}
+
+
+long stop_elevator(void)
+{
+    printk(KERN_INFO "stopping the elevator service\n");
+    return elevators_stop();
+}
+
+
+static void register_syscalls(void)
+{
+    STUB_start_elevator = start_elevator;
+    STUB_issue_request = issue_request;
+    STUB_issue_requests = issue_requests;
+    STUB_stop_elevator = stop_elevator;
+}
+
+
+static void remove_syscalls(void)
+{
+    STUB_start_elevator = NULL;
+    STUB_issue_request = NULL;
+    STUB_issue_requests = NULL;
+    STUB_stop_elevator = NULL;
+}
+
+
+/**
+ ***********************************************************************************************************************
+ ************************************************** Procfs Functions ***************************************************
+ ***********************************************************************************************************************
+ */
+
+static struct file_operations fops; /* proc file operaitons */
+
+
+/* print the floor part of `snap` */
+static void floor_proc_show(struct seq_file *m, const ElevatorSnapshot *snap, int floor_num)
+{
+    const FloorSnapshot *floor = &snap->floors[floor_num];
+    int per_min = floor->arrival_rate * (60 / ARRIVAL_WINDOW);
+    seq_printf(
+        m,
+        "Floor %d status\n"             \
+        "Load (weight):\t\t%d.%d\n"     \
+        "Load (units):\t\t%d\n"         \
+        "Load (types):\t\t%d %d %d %d\n"    \
+        "Total waiting:\t\t%d\n"        \
+        "Waiting up/down:\t%d %d\n"      \
+        "Total serviced:\t\t%d\n"       \
+        "Arrivals/min:\t\t%d.%02d\n"   \
+        "Assigned car:\t\t%d\n"       \
+        "--------------------------------------------------------------\n",
+        floor_num + 1,
+        LOAD_WEIGHT_WHOLE(&floor->load), LOAD_WEIGHT_TENTHS(&floor->load),
+        floor->load.units,
+        floor->load.by_type[CHILD], floor->load.by_type[ADULT],
+        floor->load.by_type[BELLHOP], floor->load.by_type[ROOM_SERVICE],
+        floor->load.count,
+        floor->hall_waiting[HALL_UP], floor->hall_waiting[HALL_DOWN],
+        floor->num_serviced,
+        per_min >> ARRIVAL_RATE_SHIFT, ((per_min & ((1 << ARRIVAL_RATE_SHIFT) - 1)) * 100) >> ARRIVAL_RATE_SHIFT,
+        floor->car >= 0 ? floor->car + 1 : -1
+    );
+}
+
+/* print car `car_num` of `snap`, numbered from 1 like the floors */
+static void car_proc_show(struct seq_file *m, const ElevatorSnapshot *snap, int car_num)
+{
+    const CarSnapshot *car = &snap->cars[car_num];
+    seq_printf(
+        m,
+        "Elevator %d status\n"      \
+        "Policy: \t\t%s\n"         \
+        "State: \t\t\t%s\n"         \
+        "Floor:\t\t\t%d\n"          \
+        "Next floor:\t\t%d\n"       \
+        "Load (weight):\t\t%d.%d\n"    \
+        "Load (units):\t\t%d\n"     \
+        "Load (types):\t\t%d %d %d %d\n"    \
+        "Num serviced:\t\t%d\n"       \
+        "Calls:\t\t\t%d\n"          \
+        "Park floor:\t\t%d\n"         \
+        "Parking:\t\t%d decisions, %d/%d hits\n"  \
+        "Boarded past head:\t%d\n"     \
+        "Last drain:\t\t%u.%03us%s\n"  \
+        "--------------------------------------------------------------\n",
+        car_num + 1,
+        car->policy ? car->policy : "-", ELEVATOR_STATE_STRINGS[car->state], car->current_floor + 1,
+        car->state != IDLE ? car->next_floor + 1 : -1,
+        LOAD_WEIGHT_WHOLE(&car->load), LOAD_WEIGHT_TENTHS(&car->load),
+        car->load.units,
+        car->load.by_type[CHILD], car->load.by_type[ADULT],
+        car->load.by_type[BELLHOP], car->load.by_type[ROOM_SERVICE],
+        car->total_serviced,
+        car->num_calls,
+        car->park_target >= 0 ? car->park_target + 1 : -1,
+        car->park_decisions, car->park_hits, car->park_hits + car->park_misses,
+        car->overtakes,
+        car->drain_ms / MSEC_PER_SEC, car->drain_ms % MSEC_PER_SEC, car->stopping ? " (draining now)" : ""
+    );
+}
+
+/**
+ * print the bank, every car, every floor and the passenger cache from one snapshot (`m->private`, allocated per open),
+ * so a read takes no lock the car threads use and every car's numbers are from the same moment
+ */
+static int elevator_proc_show(struct seq_file *m, void *v)
+{
+    ElevatorSnapshot *snap = m->private;
+    int i, busy = 0, serviced = 0, count = 0, units = 0;
+    elevator_snapshot(snap);
+    for (i = 0; i < snap->num_cars; i++) {
+        busy += snap->cars[i].state != OFFLINE && snap->cars[i].state != IDLE;
+        serviced += snap->cars[i].total_serviced;
+        count += snap->cars[i].load.count;
+        units += snap->cars[i].load.units;
+    }
+    seq_printf(
+        m,
+        "Bank status\n"             \
+        "Building:\t\t%d floors, %ums between floors, %ums stops, time x%u\n"   \
+        "Cars:\t\t\t%d (%d busy)\n"   \
+        "Passengers:\t\t%d (%d units)\n"    \
+        "Num serviced:\t\t%d\n"       \
+        "Calls dispatched:\t%ld\n"     \
+        "--------------------------------------------------------------\n",
+        snap->num_floors, elevator_travel_ms, elevator_stop_ms, elevator_time_scale,
+        snap->num_cars, busy, count, units, serviced, snap->dispatched
+    );
+    for (i = 0; i < snap->num_cars; i++)
+        car_proc_show(m, snap, i);
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++)
+        floor_proc_show(m, snap, i);
+    seq_printf(
+        m,
+        "Passenger cache\n"         \
+        "Object size:\t\t%zu\n"     \
+        "Live:\t\t\t%d (%ld KiB)\n"  \
+        "Allocated:\t\t%ld\n"       \
+        "Failed:\t\t\t%d\n"         \
+        "--------------------------------------------------------------\n",
+        sizeof(PassengerNode),
+        snap->passengers_live, (long) snap->passengers_live * (long) sizeof(PassengerNode) / 1024,
+        snap->passengers_allocated,
+        snap->passengers_failed
+    );
+    return 0;
+}
+
+/* every open gets its own seq_file and snapshot (vmalloc'd, it grows with the floors), so readers share nothing */
+int elevator_proc_open(struct inode *sp_inode, struct file *sp_file) {
+    ElevatorSnapshot *snap = vmalloc(sizeof(ElevatorSnapshot));
+    int ret;
+    if (snap == NULL) {
+        printk(KERN_WARNING "elevator_proc_open: failed to allocate snapshot\n");
+        return -ENOMEM;
+    }
+    ret = single_open(sp_file, elevator_proc_show, snap);
+    if (ret)
+        vfree(snap);
+    return ret;
+}
+
+/* writing a policy name (e.g. `echo look > /proc/elevator`) switches every car's scheduling policy */
+ssize_t elevator_proc_write(struct file *sp_file, const char __user *buf, size_t size, loff_t *offset) {
+    char name[POLICY_NAME_SIZE];
+    int i;
+    if (size >= POLICY_NAME_SIZE)
+        return -EINVAL;
+    if (copy_from_user(name, buf, size))
+        return -EFAULT;
+    name[size] = '\0';
+    for (i = 0; i < num_elevators; i++) {
+        if (elevator_set_policy(elevators[i], strim(name))) {
+            printk(KERN_WARNING "elevator_proc_write: unknown policy %s\n", strim(name));
+            return -EINVAL;
+        }
+    }
+    printk(KERN_INFO "elevator scheduling policy: %s\n", elevators[0]->policy->name);
+    return size;
+}
+
+int elevator_proc_release(struct inode *sp_inode, struct file *sp_file) {
+    struct seq_file *m = sp_file->private_data;
+    vfree(m->private);
+    return single_release(sp_inode, sp_file);
+}
+
+static struct file_operations stats_fops; /* /proc/elevator_stats operations */
+
+
+/* one row of the stats table: count, mean, p50, p99 and max in ms, then every bucket up to the last non-empty one */
+static void stats_proc_show_histogram(struct seq_file *m, const char *name, int num, const LatencyHistogram *h)
+{
+    int i, last = 0;
+    seq_printf(m, "%-12s%2d %10u %10llu %10u %10u %10u  ", name, num, h->count,
+               h->count ? div_u64(h->total_ms, h->count) : 0,
+               latency_histogram_percentile(h, 50), latency_histogram_percentile(h, 99), h->max_ms);
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+        if (h->buckets[i])
+            last = i;
+    for (i = 0; i <= last; i++)
+        seq_printf(m, " %u", h->buckets[i]);
+    seq_putc(m, '\n');
+}
+
+static void stats_proc_show_table(struct seq_file *m, const char *title, const LatencyHistogram *by_floor,
+                                  const LatencyHistogram *by_type)
+{
+    int i;
+    seq_printf(m, "%s\n%-14s %10s %10s %10s %10s %10s  %s\n", title, "", "count", "mean ms", "p50 <=ms", "p99 <=ms",
+               "max ms", "buckets: <2ms [2,4) [4,8) ...");
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++)
+        stats_proc_show_histogram(m, "floor", i + 1, &by_floor[i]);
+    for (i = 0; i < NUM_PASSENGER_TYPES; i++)
+        stats_proc_show_histogram(m, PASSENGER_TYPE_STRINGS[i], i + 1, &by_type[i]);
+    seq_puts(m, "--------------------------------------------------------------\n");
+}
+
+/* the latency histograms of every car added up, into a copy (`m->private`, allocated per open) */
+static int stats_proc_show(struct seq_file *m, void *v)
+{
+    ElevatorStats *stats = m->private;
+    elevators_stats_copy(stats);
+    stats_proc_show_table(m, "Wait time (issue to board), by start floor and type", stats->wait_by_floor,
+                          stats->wait_by_type);
+    stats_proc_show_table(m, "Ride time (board to alight), by destination floor and type", stats->ride_by_floor,
+                          stats->ride_by_type);
+    return 0;
+}
+
+int stats_proc_open(struct inode *sp_inode, struct file *sp_file) {
+    ElevatorStats *stats = vmalloc(sizeof(ElevatorStats));
+    int ret;
+    if (stats == NULL) {
+        printk(KERN_WARNING "stats_proc_open: failed to allocate stats\n");
+        return -ENOMEM;
+    }
+    ret = single_open(sp_file, stats_proc_show, stats);
+    if (ret)
+        vfree(stats);
+    return ret;
+}
+
+/* writing `reset` (e.g. `echo reset > /proc/elevator_stats`) clears every histogram */
+ssize_t stats_proc_write(struct file *sp_file, const char __user *buf, size_t size, loff_t *offset) {
+    char cmd[8];
+    if (size >= sizeof(cmd))
+        return -EINVAL;
+    if (copy_from_user(cmd, buf, size))
+        return -EFAULT;
+    cmd[size] = '\0';
+    if (strcmp(strim(cmd), "reset") != 0)
+        return -EINVAL;
+    elevators_stats_reset();
+    return size;
+}
+
+/**
+ ***********************************************************************************************************************
+ ************************************************** Event Device *******************************************************
+ ***********************************************************************************************************************
+ */
+
+#define EVENTS_LOST 0xff        /* `event` of the record standing in for records a full reader missed */
+
+/**
+ * One record read from /dev/elevator_events, 32 bytes, same layout as `struct elevator_event` in
+ * testing/elevator5_events/events.c. `floor` is 0-indexed, `state` is the elevator's state after the event.
+ * For BOARD `since_ns` is when the request was issued (so `time_ns - since_ns` is the wait), for ALIGHT it is when the
+ * passenger boarded (the ride). For EVENTS_LOST `passenger_id` is the number of records that were dropped.
+ */
+typedef struct {
+    u64 time_ns;            /* elevator_now_ns() of the event, building time */
+    u64 since_ns;
+    u32 passenger_id;
+    u8 event;               /* ElevatorEvent, or EVENTS_LOST */
+    u8 state;               /* ElevatorState */
+    u8 floor;
+    u8 passenger_type;
+    u8 destination_floor;
+    u8 car;                 /* car the event happened to, from 0 */
+    u8 reserved[6];
+} ElevatorEventRecord;
+
+/* one open file of /dev/elevator_events */
+typedef struct {
+    struct list_head node;          /* link in `event_readers` */
+    DECLARE_KFIFO(fifo, ElevatorEventRecord, EVENTS_FIFO_SIZE);
+    wait_queue_head_t waitq;        /* `read` and `poll` wait here for records */
+    struct mutex read_lock;         /* the fifo takes one reader at a time */
+    unsigned int dropped;           /* records lost to a full fifo, reported with an EVENTS_LOST record */
+} EventReader;
+
+static LIST_HEAD(event_readers);
+static DEFINE_SPINLOCK(event_readers_lock);    /* protects `event_readers` and serialises the fifos' producers */
+
+
+/**
+ * queue a record of the event for every reader, never blocks: a reader that falls EVENTS_FIFO_SIZE records behind
+ * misses the newest ones until it catches up
+ * NOTE: called with `elv` locked (see `elevator_notify`)
+ */
+static void events_emit(Elevator *elv, ElevatorEvent event, PassengerNode *p)
+{
+    ElevatorEventRecord record = {
+        .time_ns = elevator_now_ns(),
+        .event = event,
+        .state = elv->state,
+        .floor = elv->current_floor,
+        .car = elv->id,
+    };
+    EventReader *reader;
+    unsigned long flags;
+    /* the usual case, nobody is listening. Unlocked, careful against a concurrent open/release: a reader that opens
+     * meanwhile misses at most this event */
+    if (list_empty_careful(&event_readers))
+        return;
+    if (p) {
+        record.since_ns = event == ELEVATOR_EVENT_BOARD ? p->issued_ns : p->boarded_ns;
+        record.passenger_id = p->id;
+        record.passenger_type = p->passenger_type;
+        record.destination_floor = p->destination_floor;
+    }
+    spin_lock_irqsave(&event_readers_lock, flags);
+    list_for_each_entry(reader, &event_readers, node) {
+        if (reader->dropped && kfifo_avail(&reader->fifo) >= 2) {
+            ElevatorEventRecord lost = {.time_ns = record.time_ns, .event = EVENTS_LOST,
+                                        .passenger_id = reader->dropped};
+            kfifo_put(&reader->fifo, lost);
+            reader->dropped = 0;
+        }
+        if (reader->dropped || !kfifo_put(&reader->fifo, record))
+            reader->dropped++;
+        wake_up_interruptible(&reader->waitq);
+    }
+    spin_unlock_irqrestore(&event_readers_lock, flags);
+}
+
+
+static int events_open(struct inode *inode, struct file *file)
+{
+    EventReader *reader = kzalloc(sizeof(EventReader), GFP_KERNEL);
+    unsigned long flags;
+    if (!reader)
+        return -ENOMEM;
+    INIT_KFIFO(reader->fifo);
+    init_waitqueue_head(&reader->waitq);
+    mutex_init(&reader->read_lock);
+    spin_lock_irqsave(&event_readers_lock, flags);
+    list_add_tail(&reader->node, &event_readers);
+    spin_unlock_irqrestore(&event_readers_lock, flags);
+    file->private_data = reader;
+    return nonseekable_open(inode, file);
+}
+
+/* blocks until there is at least one record (unless O_NONBLOCK), then returns as many whole records as fit */
+static ssize_t events_read(struct file *file, char __user *buf, size_t size, loff_t *offset)
+{
+    EventReader *reader = file->private_data;
+    unsigned int copied;
+    int ret;
+    if (size < sizeof(ElevatorEventRecord))
+        return -EINVAL;
+    if (mutex_lock_interruptible(&reader->read_lock))
+        return -ERESTARTSYS;
+    while (kfifo_is_empty(&reader->fifo)) {
+        mutex_unlock(&reader->read_lock);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(reader->waitq, !kfifo_is_empty(&reader->fifo)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&reader->read_lock))
+            return -ERESTARTSYS;
+    }
+    ret = kfifo_to_user(&reader->fifo, buf, size - size % sizeof(ElevatorEventRecord), &copied);
+    mutex_unlock(&reader->read_lock);
+    return ret ? ret : copied;
+}
+
+static unsigned int events_poll(struct file *file, poll_table *wait)
+{
+    EventReader *reader = file->private_data;
+    poll_wait(file, &reader->waitq, wait);
+    return kfifo_is_empty(&reader->fifo) ? 0 : POLLIN | POLLRDNORM;
+}
+
+static int events_release(struct inode *inode, struct file *file)
+{
+    EventReader *reader = file->private_data;
+    unsigned long flags;
+    spin_lock_irqsave(&event_readers_lock, flags);
+    list_del(&reader->node);
+    spin_unlock_irqrestore(&event_readers_lock, flags);
+    kfree(reader);
+    return 0;
+}
+
+static const struct file_operations events_fops = {
+    .owner = THIS_MODULE,
+    .open = events_open,
+    .read = events_read,
+    .poll = events_poll,
+    .release = events_release,
+    .llseek = no_llseek,
+};
+
+static struct miscdevice events_device = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = EVENTS_NAME,
+    .fops = &events_fops,
+    .mode = 0444,
+};
+
+/**
+ ***********************************************************************************************************************
+ ************************************************** Module Functions ***************************************************
+ ***********************************************************************************************************************
+ */
+
+
+static int elevator_module_init(void)
+{
+    int i, ret = -ENOMEM;
+    printk("elevator_module_init called\n");
+    if (elevator_config_check())
+        return -EINVAL;
+    if (!elevator_find_policy(policy)) {
+        printk(KERN_WARNING "elevator_module_init: unknown policy %s\n", policy);
+        return -EINVAL;
+    }
+    fops.owner = THIS_MODULE;
+    fops.open = elevator_proc_open;
+    fops.read = seq_read;
+    fops.llseek = seq_lseek;
+    fops.write = elevator_proc_write;
+    fops.release = elevator_proc_release;
+    stats_fops.owner = THIS_MODULE;
+    stats_fops.open = stats_proc_open;
+    stats_fops.read = seq_read;
+    stats_fops.llseek = seq_lseek;
+    stats_fops.write = stats_proc_write;
+    stats_fops.release = elevator_proc_release;
+
+    /* on failure undo what was set up, in the reverse order (the same order as elevator_module_exit) */
+    if (!proc_create(PROC_NAME, PROC_PERMS, PROC_PARENT_DIR, &fops)) {
+        printk(KERN_WARNING "elevator_module_init: failed to create proc file");
+        return -ENOMEM;
+    }
+    if (!proc_create(STATS_PROC_NAME, PROC_PERMS, PROC_PARENT_DIR, &stats_fops)) {
+        printk(KERN_WARNING "elevator_module_init: failed to create stats proc file");
+        goto err_proc;
+    }
+    if (passenger_cache_create())
+        goto err_stats_proc;
+    ret = misc_register(&events_device);
+    if (ret) {
+        printk(KERN_WARNING "elevator_module_init: failed to register /dev/%s\n", EVENTS_NAME);
+        goto err_cache;
+    }
+    ret = -ENOMEM;
+    floors = create_floors_array(NUM_FLOORS);
+    if (!floors)
+        goto err_events;
+    elevators = create_elevators_array(cars);
+    if (!elevators)
+        goto err_floors;
+    if (car_drivers_create())
+        goto err_elevators;
+    for (i = 0; i < num_elevators; i++)
+        elevator_set_policy(elevators[i], policy);
+    /* last: once the stubs point here a syscall can come in, and a failed init must not leave them behind */
+    register_syscalls();
+    return 0;
+
+err_elevators:
+    free_elevators_array(elevators, num_elevators);
+    elevators = NULL;
+err_floors:
+    free_floors_array(floors, NUM_FLOORS);
+    floors = NULL;
+err_events:
+    misc_deregister(&events_device);
+err_cache:
+    passenger_cache_destroy();
+err_stats_proc:
+    remove_proc_entry(STATS_PROC_NAME, NULL);
+err_proc:
+    remove_proc_entry(PROC_NAME, NULL);
+    return ret;
+}
+
+
+static void elevator_module_exit(void)
+{
+    remove_proc_entry(STATS_PROC_NAME, NULL);
+    remove_proc_entry(PROC_NAME, NULL);
+    misc_deregister(&events_device);
+    remove_syscalls();
+    /* the cars may still be running, nothing may touch them once they are freed */
+    mutex_lock(&bank_lock);
+    if (!IS_ERR_OR_NULL(dispatcher_kthread))
+        kthread_stop(dispatcher_kthread);
+    dispatcher_kthread = NULL;
+    mutex_unlock(&bank_lock);
+    car_drivers_destroy();
+    free_floors_array(floors, NUM_FLOORS);
+    free_elevators_array(elevators, num_elevators);
+    passenger_cache_destroy();
+}
+
+
+module_init(elevator_module_init);
+module_exit(elevator_module_exit);
@@ -0,0 +1,399 @@
+#ifndef __ELEVATOR_PLATFORM_H
+#define __ELEVATOR_PLATFORM_H
+
+/**
+ * Thin platform shim so `elevator_core.c` builds both as part of the kernel module and as a userspace library.
+ * In the kernel this just pulls in the real headers. In userspace it provides the handful of kernel APIs the core uses
+ * (lists, mutexes, allocation, bitmaps, printk) and routes the clock (ktime_get_ns) to a hook implemented by the host
+ * program, which lets the simulator run the core on a virtual clock. The core never sleeps, so that is all it needs.
+ * The simulator is single threaded and gets no-op locks and plain read-modify-writes. Built with SIM_THREADED (as
+ * `sim/ingest_bench.c` is, to drive the request path from several threads) the locks are pthread mutexes and the
+ * atomics, lock-less lists and bit operations are real atomics.
+ */
+
+#ifdef __KERNEL__
+
+#include <linux/bitmap.h>   /* DECLARE_BITMAP, bitmap_weight */
+#include <linux/bitops.h>   /* set_bit, clear_bit, find_first_bit, __ffs */
+#include <linux/compiler.h> /* READ_ONCE, WRITE_ONCE */
+#include <linux/kernel.h>
+#include <linux/ktime.h>    /* ktime_get_ns */
+#include <linux/list.h>
+#include <linux/llist.h>    /* lock-less lists for the floor inboxes */
+#include <linux/math64.h>   /* div_u64, div64_u64 */
+#include <linux/mutex.h>    /* mutex */
+#include <linux/seqlock.h>  /* seqlock_t for the /proc snapshot, seqcount_t for the floor metrics */
+#include <linux/preempt.h>  /* preempt_disable around the floor seqcount writers */
+#include <linux/atomic.h>   /* atomic_t */
+#include <linux/slab.h>     /* kmalloc, kfree, kmem_cache */
+#include <linux/vmalloc.h>  /* vzalloc for the cars, whose stats grow with the floors */
+#include <linux/string.h>   /* snprintf */
+#include <linux/wait.h>     /* wait_queue_head_t, wake_up_interruptible */
+
+#else /* userspace */
+
+#ifdef SIM_THREADED
+#include <pthread.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_USEC 1000LL
+#define U32_MAX ((u32) ~0U)
+
+#define div_u64(dividend, divisor) ((u64) (dividend) / (divisor))
+#define div64_u64(dividend, divisor) ((u64) (dividend) / (u64) (divisor))
+
+/* allocation */
+#define GFP_KERNEL 0
+#define kcalloc(n, size, flags) calloc((n), (size))
+#define kmalloc(size, flags) malloc(size)
+#define kfree(p) free(p)
+#define vzalloc(size) calloc(1, (size))
+#define vfree(p) free(p)
+
+/* slab caches are plain malloc, `size` is kept so the stats can report it */
+struct kmem_cache {
+    size_t size;
+};
+
+static inline struct kmem_cache *kmem_cache_create(const char *name, size_t size, size_t align, unsigned long flags,
+                                                   void (*ctor)(void *))
+{
+    struct kmem_cache *cache = malloc(sizeof(struct kmem_cache));
+    if (cache)
+        cache->size = size;
+    return cache;
+}
+
+#define kmem_cache_zalloc(cache, flags) calloc(1, (cache)->size)
+#define kmem_cache_free(cache, obj) free(obj)
+#define kmem_cache_destroy(cache) free(cache)
+
+/* atomics */
+typedef struct {
+    int counter;
+} atomic_t;
+
+typedef struct {
+    long counter;
+} atomic_long_t;
+
+#define atomic_read(v) ((v)->counter)
+#define atomic_set(v, i) ((v)->counter = (i))
+#define atomic_long_read(v) ((v)->counter)
+#define atomic_long_set(v, i) ((v)->counter = (i))
+#ifdef SIM_THREADED
+#define atomic_inc(v) __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_dec(v) __atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_long_inc(v) __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_long_inc_return(v) __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_RELAXED)
+#else
+#define atomic_inc(v) ((v)->counter++)
+#define atomic_dec(v) ((v)->counter--)
+#define atomic_long_inc(v) ((v)->counter++)
+#define atomic_long_inc_return(v) (++(v)->counter)
+#endif
+
+/* logging, the level prefixes are plain strings in the kernel too so they just concatenate away */
+#define KERN_INFO ""
+#define KERN_WARNING ""
+#define KERN_CONT ""
+#define printk(...) printf(__VA_ARGS__)
+
+#ifdef SIM_THREADED
+struct mutex {
+    pthread_mutex_t lock;
+};
+static inline void mutex_init(struct mutex *lock) { pthread_mutex_init(&lock->lock, NULL); }
+static inline void mutex_lock(struct mutex *lock) { pthread_mutex_lock(&lock->lock); }
+static inline void mutex_unlock(struct mutex *lock) { pthread_mutex_unlock(&lock->lock); }
+#else
+/* the simulator is single threaded, so locks are no-ops */
+struct mutex {
+    int unused;
+};
+static inline void mutex_init(struct mutex *lock) {}
+static inline void mutex_lock(struct mutex *lock) {}
+static inline void mutex_unlock(struct mutex *lock) {}
+#endif
+
+static inline void preempt_disable(void) {}
+static inline void preempt_enable(void) {}
+
+/* seqlocks: there is never a concurrent reader, the sequence is only kept so the read loop looks like the kernel's */
+typedef struct {
+    unsigned int sequence;
+} seqlock_t;
+
+#define DEFINE_SEQLOCK(name) seqlock_t name = {0}
+static inline void write_seqlock(seqlock_t *sl) { sl->sequence++; }
+static inline void write_sequnlock(seqlock_t *sl) { sl->sequence++; }
+static inline unsigned int read_seqbegin(const seqlock_t *sl) { return sl->sequence; }
+static inline int read_seqretry(const seqlock_t *sl, unsigned int start) { return sl->sequence != start; }
+
+/* seqcounts, the same */
+typedef struct {
+    unsigned int sequence;
+} seqcount_t;
+
+static inline void seqcount_init(seqcount_t *s) { s->sequence = 0; }
+static inline void write_seqcount_begin(seqcount_t *s) { s->sequence++; }
+static inline void write_seqcount_end(seqcount_t *s) { s->sequence++; }
+static inline unsigned int read_seqcount_begin(const seqcount_t *s) { return s->sequence; }
+static inline int read_seqcount_retry(const seqcount_t *s, unsigned int start) { return s->sequence != start; }
+
+/* the subset of <linux/list.h> used by the core */
+struct list_head {
+    struct list_head *next, *prev;
+};
+
+#define container_of(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+#define list_first_entry(head, type, member) list_entry((head)->next, type, member)
+#define list_for_each_safe(pos, n, head) \
+    for (pos = (head)->next, n = pos->next; pos != (head); pos = n, n = pos->next)
+#define list_for_each_entry(pos, head, member) \
+    for (pos = list_entry((head)->next, __typeof__(*pos), member); \
+         &pos->member != (head); \
+         pos = list_entry(pos->member.next, __typeof__(*pos), member))
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+    list->next = list->prev = list;
+}
+
+static inline void list_add_tail(struct list_head *entry, struct list_head *head)
+{
+    entry->prev = head->prev;
+    entry->next = head;
+    head->prev->next = entry;
+    head->prev = entry;
+}
+
+static inline void list_del(struct list_head *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->next = entry->prev = NULL;
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+    return head->next == head;
+}
+
+/* the subset of <linux/llist.h> used by the core, lock-less like the real one with SIM_THREADED */
+struct llist_node {
+    struct llist_node *next;
+};
+
+struct llist_head {
+    struct llist_node *first;
+};
+
+#define llist_entry(ptr, type, member) container_of(ptr, type, member)
+/* compare as integers, `&pos->member != NULL` would be folded to true by the compiler */
+#define member_address_is_nonnull(ptr, member) \
+    ((uintptr_t) (ptr) + offsetof(__typeof__(*(ptr)), member) != 0)
+#define llist_for_each_entry_safe(pos, n, node, member) \
+    for (pos = llist_entry((node), __typeof__(*pos), member); \
+         member_address_is_nonnull(pos, member) && (n = llist_entry(pos->member.next, __typeof__(*n), member), 1); \
+         pos = n)
+
+static inline void init_llist_head(struct llist_head *list)
+{
+    list->first = NULL;
+}
+
+static inline int llist_empty(const struct llist_head *head)
+{
+    return __atomic_load_n(&head->first, __ATOMIC_RELAXED) == NULL;
+}
+
+static inline int llist_add_batch(struct llist_node *new_first, struct llist_node *new_last,
+                                  struct llist_head *head)
+{
+#ifdef SIM_THREADED
+    struct llist_node *first = __atomic_load_n(&head->first, __ATOMIC_RELAXED);
+    do {
+        new_last->next = first;
+    } while (!__atomic_compare_exchange_n(&head->first, &first, new_first, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return first == NULL;
+#else
+    new_last->next = head->first;
+    head->first = new_first;
+    return new_last->next == NULL;
+#endif
+}
+
+static inline int llist_add(struct llist_node *new, struct llist_head *head)
+{
+    return llist_add_batch(new, new, head);
+}
+
+static inline struct llist_node *llist_del_all(struct llist_head *head)
+{
+#ifdef SIM_THREADED
+    return __atomic_exchange_n(&head->first, NULL, __ATOMIC_ACQUIRE);
+#else
+    struct llist_node *first = head->first;
+    head->first = NULL;
+    return first;
+#endif
+}
+
+static inline struct llist_node *llist_reverse_order(struct llist_node *head)
+{
+    struct llist_node *new_head = NULL, *tmp;
+    while (head) {
+        tmp = head;
+        head = head->next;
+        tmp->next = new_head;
+        new_head = tmp;
+    }
+    return new_head;
+}
+
+/* bit operations, plain read-modify-write is enough single threaded, atomic with SIM_THREADED */
+#define BITS_PER_LONG (8 * sizeof(long))
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *) &(x))
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *) &(x) = (val))
+
+#define BIT_WORD(nr) ((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr) (1UL << ((nr) % BITS_PER_LONG))
+
+static inline void set_bit(int nr, volatile unsigned long *addr)
+{
+#ifdef SIM_THREADED
+    __atomic_fetch_or(&addr[BIT_WORD(nr)], BIT_MASK(nr), __ATOMIC_RELAXED);
+#else
+    addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+#endif
+}
+
+static inline void clear_bit(int nr, volatile unsigned long *addr)
+{
+#ifdef SIM_THREADED
+    __atomic_fetch_and(&addr[BIT_WORD(nr)], ~BIT_MASK(nr), __ATOMIC_RELAXED);
+#else
+    addr[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+#endif
+}
+
+static inline int test_bit(int nr, const volatile unsigned long *addr)
+{
+    return (addr[BIT_WORD(nr)] & BIT_MASK(nr)) != 0;
+}
+
+#ifdef SIM_THREADED
+static inline void smp_mb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void smp_mb__after_atomic(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#define xchg(ptr, new) __atomic_exchange_n((ptr), (new), __ATOMIC_SEQ_CST)
+#else
+static inline void smp_mb(void) {}
+static inline void smp_mb__after_atomic(void) {}
+
+#define xchg(ptr, new)                              \
+    ({                                              \
+        __typeof__(*(ptr)) __old = *(ptr);          \
+        *(ptr) = (new);                             \
+        __old;                                      \
+    })
+#endif
+
+/* index of the lowest / highest set bit, undefined for 0 like the kernel's */
+static inline unsigned long __ffs(unsigned long word)
+{
+    return __builtin_ctzl(word);
+}
+
+static inline unsigned long __fls(unsigned long word)
+{
+    return BITS_PER_LONG - 1 - __builtin_clzl(word);
+}
+
+/* the subset of <linux/bitmap.h> and the find_*_bit helpers used by the core, `size` is in bits */
+#define BITS_TO_LONGS(nr) (((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits) unsigned long name[BITS_TO_LONGS(bits)]
+
+static inline unsigned long find_next_bit(const unsigned long *addr, unsigned long size, unsigned long offset)
+{
+    for (; offset < size; offset++) {
+        if (test_bit(offset, addr))
+            return offset;
+    }
+    return size;
+}
+
+static inline unsigned long find_first_bit(const unsigned long *addr, unsigned long size)
+{
+    return find_next_bit(addr, size, 0);
+}
+
+static inline unsigned long find_last_bit(const unsigned long *addr, unsigned long size)
+{
+    unsigned long i = size;
+    while (i-- > 0) {
+        if (test_bit(i, addr))
+            return i;
+    }
+    return size;
+}
+
+#define for_each_set_bit(bit, addr, size)                   \
+    for ((bit) = find_first_bit((addr), (size));            \
+         (bit) < (size);                                    \
+         (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+static inline void bitmap_zero(unsigned long *dst, unsigned int nbits)
+{
+    memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(unsigned long));
+}
+
+static inline void bitmap_copy(unsigned long *dst, const unsigned long *src, unsigned int nbits)
+{
+    memcpy(dst, src, BITS_TO_LONGS(nbits) * sizeof(unsigned long));
+}
+
+static inline int bitmap_empty(const unsigned long *src, unsigned int nbits)
+{
+    return find_first_bit(src, nbits) >= nbits;
+}
+
+static inline int bitmap_weight(const unsigned long *src, unsigned int nbits)
+{
+    unsigned int i;
+    int weight = 0;
+    for (i = 0; i < nbits; i++)
+        weight += test_bit(i, src);
+    return weight;
+}
+
+/* the clock, implemented by the host (see sim/elevator_sim.c) */
+u64 ktime_get_ns(void);
+
+/* wait queues: nobody sleeps on one in userspace (the host plays the dispatcher), so waking is a no-op */
+typedef struct {
+    int unused;
+} wait_queue_head_t;
+
+static inline void init_waitqueue_head(wait_queue_head_t *wq) {}
+static inline void wake_up_interruptible(wait_queue_head_t *wq) {}
+static inline int wq_has_sleeper(wait_queue_head_t *wq) { return 0; }
+
+#endif /* __KERNEL__ */
+
+#endif /* __ELEVATOR_PLATFORM_H */
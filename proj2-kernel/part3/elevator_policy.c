@@ -0,0 +1,312 @@
+#include "elevator.h"
+
+/**
+ * Scheduling policies for `elevator_advance`, see `ElevatorPolicy` in elevator.h for the contract. Which floors a car has
+ * to answer comes from its `calls` bitmap (and `floors_waiting` for the floor it is at) without any locks, the floor
+ * lock is only taken to read a head.
+ */
+
+#define SSF_AGING_DIVISOR 4     /* shortest seek first: every 4s a passenger has waited counts as 1s less travel */
+
+
+/**
+ ***********************************************************************************************************************
+ ************************************************** Policy Helpers *****************************************************
+ ***********************************************************************************************************************
+ */
+
+static ElevatorState opposite(ElevatorState direction)
+{
+    return direction == UP ? DOWN : UP;
+}
+
+/* whether `floor_num` lies strictly past the car in `direction` */
+static int is_beyond(Elevator *elv, int floor_num, ElevatorState direction)
+{
+    return direction == UP ? floor_num > elv->current_floor : floor_num < elv->current_floor;
+}
+
+/**
+ * copy the passenger at the front of `floor_num`'s queue going `hall` (or either way, for NUM_HALL_DIRECTIONS) into
+ * `head`, returns 0 if nobody is waiting
+ */
+static int peek_head(int floor_num, HallDirection hall, PassengerNode *head)
+{
+    Floor *floor = floors[floor_num];
+    PassengerNode *p;
+    int found = 0;
+    mutex_lock(&floor->lock);
+    p = hall == NUM_HALL_DIRECTIONS ? floor_head(floor) : floor_hall_head(floor, hall);
+    if (p) {
+        *head = *p;
+        found = 1;
+    }
+    mutex_unlock(&floor->lock);
+    return found;
+}
+
+/* the way the passenger at the front of the current floor's queue wants to go, IDLE if nobody is waiting */
+static ElevatorState head_direction(Elevator *elv)
+{
+    PassengerNode head;
+    if (!test_bit(elv->current_floor, floors_waiting) || !peek_head(elv->current_floor, NUM_HALL_DIRECTIONS, &head))
+        return IDLE;
+    return head.destination_floor > elv->current_floor ? UP : DOWN;
+}
+
+/* the floors the car answers into `calls`: the hall calls the dispatcher assigned it, plus anyone waiting right here */
+static void car_calls(Elevator *elv, unsigned long *calls)
+{
+    elevator_calls_copy(elv, calls);
+    if (test_bit(elv->current_floor, floors_waiting))
+        set_bit(elv->current_floor, calls);
+}
+
+/* whether anybody in the car is going past the current floor in `direction` */
+static int car_has_work_beyond(Elevator *elv, ElevatorState direction)
+{
+    int i;
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        if (elv->load.by_dest[i] && is_beyond(elv, i, direction))
+            return 1;
+    }
+    return 0;
+}
+
+/* whether the car has a call from a floor past the current one in `direction` */
+static int floors_have_work_beyond(Elevator *elv, ElevatorState direction)
+{
+    DECLARE_BITMAP(waiting, MAX_NUM_FLOORS);
+    car_calls(elv, waiting);
+    if (direction == UP)
+        return find_next_bit(waiting, NUM_FLOORS, elv->current_floor + 1) < NUM_FLOORS;
+    return find_first_bit(waiting, elv->current_floor) < elv->current_floor;
+}
+
+/* direction of the closest floor (other than the current one) the car has a call from, ties go to `preferred` */
+static ElevatorState nearest_waiting_direction(Elevator *elv, ElevatorState preferred)
+{
+    DECLARE_BITMAP(waiting, MAX_NUM_FLOORS);
+    int d, up, down;
+    car_calls(elv, waiting);
+    for (d = 1; d <= MAX_FLOOR - MIN_FLOOR; d++) {
+        up = elv->current_floor + d <= MAX_FLOOR && test_bit(elv->current_floor + d, waiting);
+        down = elv->current_floor - d >= MIN_FLOOR && test_bit(elv->current_floor - d, waiting);
+        if (up && down)
+            return preferred == DOWN ? DOWN : UP;
+        if (up)
+            return UP;
+        if (down)
+            return DOWN;
+    }
+    return IDLE;
+}
+
+
+/**
+ ***********************************************************************************************************************
+ ****************************************************** SCAN ***********************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * the original scheduler: once someone boards, keep going their way until the car is empty, then start over with the
+ * passenger waiting here, or else with the lowest floor the car has a call from
+ */
+static ElevatorState scan_choose_direction(Elevator *elv)
+{
+    DECLARE_BITMAP(waiting, MAX_NUM_FLOORS);
+    ElevatorState head;
+    int lowest;
+    if (elv->load.count > 0) {
+        /* riders can be going both ways if the policy was switched mid run, finish this way first */
+        return car_has_work_beyond(elv, elv->direction) ? elv->direction : opposite(elv->direction);
+    }
+    head = head_direction(elv);
+    if (head != IDLE)
+        return head;
+    car_calls(elv, waiting);
+    lowest = find_first_bit(waiting, NUM_FLOORS);
+    if (lowest >= NUM_FLOORS)
+        return IDLE;
+    return lowest > elv->current_floor ? UP : DOWN;
+}
+
+static const ElevatorPolicy scan_policy = {
+    .name = "scan",
+    .choose_direction = scan_choose_direction,
+};
+
+
+/**
+ ***********************************************************************************************************************
+ ****************************************************** LOOK ***********************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * keep going while there is a destination or a waiting passenger further along, then turn around; at the turning
+ * floor the direction flips before boarding so the people waiting there to go back get on
+ */
+static ElevatorState look_choose_direction(Elevator *elv)
+{
+    ElevatorState direction = elv->direction, head;
+    if (direction == UP || direction == DOWN) {
+        if (car_has_work_beyond(elv, direction) || floors_have_work_beyond(elv, direction))
+            return direction;
+    }
+    else {
+        direction = IDLE;
+    }
+    head = head_direction(elv);
+    if (head != IDLE)
+        return head;
+    if (direction != IDLE) {
+        direction = opposite(direction);
+        return car_has_work_beyond(elv, direction) || floors_have_work_beyond(elv, direction) ? direction : IDLE;
+    }
+    return nearest_waiting_direction(elv, UP);
+}
+
+static const ElevatorPolicy look_policy = {
+    .name = "look",
+    .choose_direction = look_choose_direction,
+};
+
+
+/**
+ ***********************************************************************************************************************
+ ********************************************** Shortest Seek First ****************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * head for the closest stop, whether that's a destination in the car or the front of one of a floor's hall queues.
+ * Every request is discounted by how long ago it was issued (see SSF_AGING_DIVISOR), so a far away floor can't be
+ * starved by a busy neighbourhood. Queues whose head passenger wouldn't fit are skipped while the car has riders to
+ * drop off.
+ */
+static ElevatorState ssf_choose_direction(Elevator *elv)
+{
+    PassengerNode *p, head;
+    ElevatorState best_direction = IDLE;
+    DECLARE_BITMAP(calls, MAX_NUM_FLOORS);
+    u64 now = elevator_now_ns();
+    s64 cost, best_cost = 0;
+    int i, hall, fits, best = -1;
+
+    mutex_lock(&elv->lock);
+    list_for_each_entry(p, &elv->queue, queue) {
+        cost = (s64) abs(p->destination_floor - elv->current_floor) * TIME_BETWEEN_FLOORS * NSEC_PER_MSEC -
+               (s64) ((now - p->issued_ns) / SSF_AGING_DIVISOR);
+        if (best < 0 || cost < best_cost) {
+            best = p->destination_floor;
+            best_cost = cost;
+        }
+    }
+    mutex_unlock(&elv->lock);
+
+    car_calls(elv, calls);
+    for_each_set_bit(i, calls, NUM_FLOORS) {
+        for (hall = HALL_UP; hall < NUM_HALL_DIRECTIONS; hall++) {
+            if (!peek_head(i, hall, &head))
+                continue;
+            mutex_lock(&elv->lock);
+            fits = elv->load.count == 0 || elevator_can_fit(elv, &head);
+            mutex_unlock(&elv->lock);
+            if (!fits)
+                continue;
+            cost = (s64) abs(i - elv->current_floor) * TIME_BETWEEN_FLOORS * NSEC_PER_MSEC -
+                   (s64) ((now - head.issued_ns) / SSF_AGING_DIVISOR);
+            if (best < 0 || cost < best_cost) {
+                best = i;
+                best_cost = cost;
+                best_direction = hall == HALL_UP ? UP : DOWN;
+            }
+        }
+    }
+
+    if (best < 0)
+        return IDLE;
+    if (best != elv->current_floor)
+        return best > elv->current_floor ? UP : DOWN;
+    /* the best stop is the queue right here, so go whichever way its head passenger is going */
+    return best_direction;
+}
+
+static const ElevatorPolicy ssf_policy = {
+    .name = "ssf",
+    .choose_direction = ssf_choose_direction,
+};
+
+
+/**
+ ***********************************************************************************************************************
+ ****************************************************** Lobby **********************************************************
+ ***********************************************************************************************************************
+ */
+
+/**
+ * most riders above the lobby are going down to it, so an empty car climbs to the highest floor it has a call from
+ * and then sweeps down, collecting everyone headed the same way until it reaches the lobby. With riders aboard it
+ * behaves like LOOK, and while idle it waits at the lobby
+ */
+static ElevatorState lobby_choose_direction(Elevator *elv)
+{
+    DECLARE_BITMAP(waiting, MAX_NUM_FLOORS);
+    int top;
+    if (elv->load.count > 0)
+        return look_choose_direction(elv);
+    car_calls(elv, waiting);
+    top = find_last_bit(waiting, NUM_FLOORS);
+    if (top >= NUM_FLOORS)
+        return IDLE;
+    if (top > elv->current_floor)
+        return UP;
+    if (top < elv->current_floor)
+        return DOWN;
+    return head_direction(elv) == UP ? UP : DOWN;
+}
+
+static int lobby_park_floor(Elevator *elv)
+{
+    return MIN_FLOOR;
+}
+
+static const ElevatorPolicy lobby_policy = {
+    .name = "lobby",
+    .choose_direction = lobby_choose_direction,
+    .park_floor = lobby_park_floor,
+};
+
+
+/**
+ ***********************************************************************************************************************
+ ************************************************* Policy Registry *****************************************************
+ ***********************************************************************************************************************
+ */
+
+const ElevatorPolicy *ELEVATOR_POLICIES[] = {&scan_policy, &look_policy, &ssf_policy, &lobby_policy, NULL};
+
+
+const ElevatorPolicy *elevator_find_policy(const char *name)
+{
+    int i;
+    for (i = 0; ELEVATOR_POLICIES[i]; i++)
+        if (strcmp(ELEVATOR_POLICIES[i]->name, name) == 0)
+            return ELEVATOR_POLICIES[i];
+    return NULL;
+}
+
+
+int elevator_set_policy(Elevator *elv, const char *name)
+{
+    const ElevatorPolicy *policy = elevator_find_policy(name);
+    if (!policy)
+        return -1;
+    mutex_lock(&elv->lock);
+    elv->policy = policy;
+    elevator_publish_policy(elv);
+    mutex_unlock(&elv->lock);
+    return 0;
+}
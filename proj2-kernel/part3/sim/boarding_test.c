@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+/**
+ * Checks boarding in elevator_core.c: the per-direction, per-type floor queues still give FIFO order, a car boards
+ * only from the queue going its way, strict FIFO stops at a head that doesn't fit, and relaxed FIFO
+ * (`elevator_board_window`) boards the passengers behind it that do, up to the window, and never past a head that has
+ * waited `elevator_board_max_wait_ms`.
+ */
+
+/* a fresh building with the car at floor 0 about to leave going up, carrying `types` */
+static Elevator *setup(const int *types, int count)
+{
+    PassengerNode *p;
+    int i;
+    floors = create_floors_array(NUM_FLOORS);
+    elevators = create_elevators_array(1);
+    elevators[0]->direction = UP;
+    for (i = 0; i < count; i++) {
+        p = passenger_node_create(types[i], 9);
+        list_add_tail(&p->queue, &elevators[0]->queue);
+        load_add(&elevators[0]->load, p);
+    }
+    return elevators[0];
+}
+
+static void teardown(void)
+{
+    free_elevators_array(elevators, num_elevators);
+    free_floors_array(floors, NUM_FLOORS);
+}
+
+/* queue a passenger of `type` going to `dest` on floor 0, returns its id */
+static u32 wait_at_lobby(int type, int dest)
+{
+    PassengerNode *p = passenger_node_create(type, dest);
+    floor_enqueue_passenger(floors[0], p);
+    return p->id;
+}
+
+/* the head is the earliest passenger whatever their type, and taking one out of the middle keeps the counts right */
+static void test_floor_order(void)
+{
+    u32 child, bellhop, adult;
+    PassengerNode *p;
+    setup(NULL, 0);
+    child = wait_at_lobby(CHILD, 3);
+    bellhop = wait_at_lobby(BELLHOP, 4);
+    adult = wait_at_lobby(ADULT, 5);
+    wait_at_lobby(CHILD, 6);
+    p = floor_head(floors[0]);
+    CHECK(p && p->id == child, "head is not the first child");
+    passenger_node_free(floor_dequeue_passenger(floors[0], p));
+    p = floor_head(floors[0]);
+    CHECK(p && p->id == bellhop, "head is not the bellhop after the first child");
+    /* the adult boards past the bellhop */
+    p = list_first_entry(&floors[0]->queues[HALL_UP][ADULT], PassengerNode, queue);
+    CHECK(p->id == adult, "adult queue head");
+    passenger_node_free(floor_dequeue_passenger(floors[0], p));
+    CHECK(floors[0]->load.count == 2 && floors[0]->load.by_type[ADULT] == 0 && floors[0]->load.by_type[CHILD] == 1,
+          "floor load %d, %d adults, %d children", floors[0]->load.count, floors[0]->load.by_type[ADULT],
+          floors[0]->load.by_type[CHILD]);
+    CHECK(floor_head(floors[0])->id == bellhop, "head changed when the adult left");
+    CHECK(test_bit(0, floors_waiting), "floor 0 not waiting with 2 queued");
+    teardown();
+}
+
+/**
+ * a car with 4 room service (12 weight) and a child (12.5) has room for 5 more children by weight (the unit limit is
+ * raised out of the way) but not for the room service at the head of the queue
+ */
+static const int NEARLY_FULL[5] = {ROOM_SERVICE, ROOM_SERVICE, ROOM_SERVICE, ROOM_SERVICE, CHILD};
+
+static int board_behind_room_service(int window, u64 waited_ms)
+{
+    Elevator *elv = setup(NEARLY_FULL, 5);
+    int i, boarded;
+    elevator_board_window = window;
+    now = 0;
+    wait_at_lobby(ROOM_SERVICE, 5);
+    for (i = 0; i < 8; i++)
+        wait_at_lobby(CHILD, 2 + i % 7);
+    now = waited_ms * NSEC_PER_MSEC;
+    boarded = elevator_load_floor(elv);
+    CHECK(elv->load.half_weight <= MAX_LOAD_HALF_WEIGHT, "over the weight limit with window %d", window);
+    CHECK(elv->overtakes == boarded, "%d overtakes counted for %d boarded", elv->overtakes, boarded);
+    CHECK(floors[0]->load.count == 9 - boarded, "%d left on the floor after %d boarded", floors[0]->load.count,
+          boarded);
+    CHECK(floor_head(floors[0])->passenger_type == ROOM_SERVICE, "the room service lost its place");
+    teardown();
+    return boarded;
+}
+
+static void test_relaxed_window(void)
+{
+    int boarded;
+    elevator_max_load_units = 20;
+    boarded = board_behind_room_service(0, 0);
+    CHECK(boarded == 0, "strict FIFO boarded %d past the head", boarded);
+    boarded = board_behind_room_service(1, 0);
+    CHECK(boarded == 1, "window 1 boarded %d", boarded);
+    boarded = board_behind_room_service(3, 0);
+    CHECK(boarded == 3, "window 3 boarded %d", boarded);
+    boarded = board_behind_room_service(16, 0);
+    CHECK(boarded == 5, "window 16 boarded %d, room for 5 children", boarded);
+    /* starvation protection: the head has waited too long to be passed */
+    boarded = board_behind_room_service(16, elevator_board_max_wait_ms - 1);
+    CHECK(boarded == 5, "window 16 boarded %d just under the max wait", boarded);
+    boarded = board_behind_room_service(16, elevator_board_max_wait_ms);
+    CHECK(boarded == 0, "window 16 boarded %d past a head at the max wait", boarded);
+    elevator_max_load_units = 10;
+    elevator_board_window = 0;
+}
+
+/* a car boards from the hall queue going its way, whoever is at the front of the other one */
+static void test_hall_queues(void)
+{
+    Elevator *elv;
+    PassengerNode *p;
+    u32 down;
+    int boarded;
+
+    /* the car is at floor 4 going up: the adult going down was first, the child going up boards anyway */
+    elv = setup(NULL, 0);
+    elv->current_floor = 4;
+    p = passenger_node_create(ADULT, 1);
+    down = p->id;
+    floor_enqueue_passenger(floors[4], p);
+    floor_enqueue_passenger(floors[4], passenger_node_create(CHILD, 8));
+    floor_enqueue_passenger(floors[4], passenger_node_create(BELLHOP, 9));
+    CHECK(floors[4]->hall_waiting[HALL_UP] == 2 && floors[4]->hall_waiting[HALL_DOWN] == 1, "waiting up %d, down %d",
+          floors[4]->hall_waiting[HALL_UP], floors[4]->hall_waiting[HALL_DOWN]);
+    CHECK(floor_head(floors[4])->id == down, "the floor's head isn't the first passenger whichever way they go");
+    boarded = elevator_load_floor(elv);
+    CHECK(boarded == 2 && elv->load.by_dest[8] == 1 && elv->load.by_dest[9] == 1, "boarded %d going up", boarded);
+    CHECK(floors[4]->hall_waiting[HALL_UP] == 0 && floors[4]->hall_waiting[HALL_DOWN] == 1,
+          "waiting up %d, down %d after boarding", floors[4]->hall_waiting[HALL_UP], floors[4]->hall_waiting[HALL_DOWN]);
+    CHECK(floor_head(floors[4])->id == down, "the adult going down lost their place");
+    /* turning around at the same floor takes the adult */
+    elv->direction = DOWN;
+    boarded = elevator_load_floor(elv);
+    CHECK(boarded == 1 && elv->load.by_dest[1] == 1, "boarded %d going down", boarded);
+    CHECK(floors[4]->load.count == 0 && !floor_head(floors[4]) && !test_bit(4, floors_waiting), "floor 4 not empty");
+    teardown();
+
+    /* relaxed: the room service going up doesn't fit, the child going down is skipped, the child going up boards */
+    elevator_max_load_units = 20;
+    elevator_board_window = 16;
+    elv = setup(NEARLY_FULL, 5);
+    elv->current_floor = 4;
+    floor_enqueue_passenger(floors[4], passenger_node_create(ROOM_SERVICE, 8));
+    floor_enqueue_passenger(floors[4], passenger_node_create(CHILD, 1));
+    floor_enqueue_passenger(floors[4], passenger_node_create(CHILD, 7));
+    boarded = elevator_load_floor(elv);
+    CHECK(boarded == 1 && elv->load.by_dest[7] == 1 && elv->overtakes == 1, "boarded %d, the child going up", boarded);
+    CHECK(floors[4]->hall_waiting[HALL_UP] == 1 && floors[4]->hall_waiting[HALL_DOWN] == 1, "waiting up %d, down %d",
+          floors[4]->hall_waiting[HALL_UP], floors[4]->hall_waiting[HALL_DOWN]);
+    teardown();
+    elevator_max_load_units = 10;
+    elevator_board_window = 0;
+}
+
+int main(void)
+{
+    if (passenger_cache_create())
+        return 1;
+    test_floor_order();
+    test_relaxed_window();
+    test_hall_queues();
+    passenger_cache_destroy();
+    return check_summary("boarding_test");
+}
@@ -0,0 +1,48 @@
+#ifndef __CHECK_H
+#define __CHECK_H
+
+#include <stdio.h>
+#include "elevator.h"
+
+/**
+ * What the sim's unit tests share: the CHECK macro and its counters, the summary line, and the platform hooks (see
+ * elevator_platform.h) for the core they link. The clock is `now`, set by the test (it stays at 0 in the tests that
+ * run no car). A test that watches the car's events or resumes defines CHECK_OWN_NOTIFY or CHECK_OWN_RESUME before
+ * including this and implements that hook itself.
+ */
+
+static int checks, failures;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failures++;                                 \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+/* print the counts, returns the test's exit status */
+static int check_summary(const char *test)
+{
+    printf("%s: %d checks, %d failures\n", test, checks, failures);
+    return failures != 0;
+}
+
+
+/******************************************************************************/
+/* platform hooks */
+
+static u64 now;
+
+u64 ktime_get_ns(void) { return now; }
+#ifndef CHECK_OWN_NOTIFY
+void elevator_notify(Elevator *elv, ElevatorEvent event, PassengerNode *p) {}
+#endif
+#ifndef CHECK_OWN_RESUME
+void elevator_resume(Elevator *elv) {}
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define CHECK_OWN_NOTIFY
+#define CHECK_OWN_RESUME
+#include "check.h"
+
+/**
+ * Checks the stop path in elevator_core.c: a car told to `elevator_stop` with a full load delivers everyone, opens its
+ * doors only where somebody gets off, takes the shortest route (to the nearer end of its riders' destinations first),
+ * reports the time in `drain_ns` and the snapshot, and goes OFFLINE. Plays the module's timer with a fake clock.
+ */
+
+/******************************************************************************/
+/* the platform hooks this test watches, the clock is check.h's `now` */
+
+static int resumed;
+static int alighted_at[MAX_NUM_FLOORS], doors_at[MAX_NUM_FLOORS];
+
+void elevator_resume(Elevator *elv) { resumed = 1; }
+
+void elevator_notify(Elevator *elv, ElevatorEvent event, PassengerNode *p)
+{
+    if (event == ELEVATOR_EVENT_ALIGHT) {
+        CHECK(p->destination_floor == elv->current_floor, "passenger for %d got off at %d", p->destination_floor,
+              elv->current_floor);
+        alighted_at[elv->current_floor]++;
+    }
+    else if (event == ELEVATOR_EVENT_STATE && elv->state == LOADING) {
+        doors_at[elv->current_floor]++;
+    }
+}
+
+
+/******************************************************************************/
+
+/* put `count` passengers straight into the car, as if they had boarded at its current floor */
+static void board(Elevator *elv, const int *dests, int count)
+{
+    PassengerNode *p;
+    int i;
+    for (i = 0; i < count; i++) {
+        p = passenger_node_create(ADULT, dests[i]);
+        p->boarded_ns = now;
+        list_add_tail(&p->queue, &elv->queue);
+        load_add(&elv->load, p);
+    }
+}
+
+/* advance the car like its timer would until it stops asking for one, returns the number of steps */
+static int run_until_waiting(Elevator *elv)
+{
+    int ms, steps = 0;
+    resumed = 0;
+    while ((ms = elevator_advance(elv)) != ELEVATOR_WAIT && steps < 10000) {
+        now += ms * (u64) NSEC_PER_MSEC;
+        steps++;
+    }
+    return steps;
+}
+
+/* the shortest drain for riders going to `dests` from `start`: nearer end first, one stop per destination floor */
+static u64 shortest_drain_ms(int start, const int *dests, int count)
+{
+    int lowest = start, highest = start, stops = 0, i, below, above;
+    int seen[MAX_NUM_FLOORS] = {0};
+    for (i = 0; i < count; i++) {
+        if (dests[i] < lowest)
+            lowest = dests[i];
+        if (dests[i] > highest)
+            highest = dests[i];
+        if (!seen[dests[i]]++)
+            stops++;
+    }
+    below = start - lowest;
+    above = highest - start;
+    return (u64) ((below < above ? 2 * below + above : below + 2 * above) * TIME_BETWEEN_FLOORS) +
+           (u64) stops * TIME_AT_FLOOR;
+}
+
+/**
+ * start a car at `start`, fill it with riders for `dests` and stop it right away, then check it delivers them all on
+ * the shortest route and stops nowhere else
+ */
+static void check_drain(int start, const int *dests, int count)
+{
+    Elevator *elv = elevators[0];
+    ElevatorSnapshot *snap = malloc(sizeof(ElevatorSnapshot));
+    u64 want = shortest_drain_ms(start, dests, count);
+    int riders_for[MAX_NUM_FLOORS] = {0}, i;
+    for (i = 0; i < count; i++)
+        riders_for[dests[i]]++;
+    memset(alighted_at, 0, sizeof(alighted_at));
+    memset(doors_at, 0, sizeof(doors_at));
+    elv->current_floor = elv->next_floor = start;
+    CHECK(elevator_start(elv) == 0, "start from %d", start);
+    CHECK(resumed, "start didn't resume the car");
+    board(elv, dests, count);
+    CHECK(elevator_stop(elv) == 0, "stop from %d", start);
+    CHECK(elevator_stop(elv) == 1, "second stop from %d accepted", start);
+    run_until_waiting(elv);
+
+    CHECK(elv->state == OFFLINE, "state %s after the drain from %d", ELEVATOR_STATE_STRINGS[elv->state], start);
+    CHECK(elv->load.count == 0 && list_empty(&elv->queue), "%d riders left from %d", elv->load.count, start);
+    CHECK(!elv->stopping, "still stopping once OFFLINE");
+    for (i = MIN_FLOOR; i <= MAX_FLOOR; i++) {
+        CHECK(alighted_at[i] == riders_for[i], "%d got off at floor %d, want %d", alighted_at[i], i, riders_for[i]);
+        CHECK(doors_at[i] == (alighted_at[i] > 0), "doors opened %d times at floor %d where %d got off, from %d",
+              doors_at[i], i, alighted_at[i], start);
+    }
+    CHECK(elv->drain_ns == want * NSEC_PER_MSEC, "drain from %d took %llums, the shortest is %llums", start,
+          (unsigned long long) (elv->drain_ns / NSEC_PER_MSEC), (unsigned long long) want);
+    elevator_snapshot(snap);
+    CHECK(snap->cars[0].drain_ms == want && !snap->cars[0].stopping, "snapshot drain %ums, want %llums",
+          snap->cars[0].drain_ms, (unsigned long long) want);
+    CHECK(elevator_stop(elv) == 1, "stop accepted while OFFLINE");
+    free(snap);
+}
+
+/* a full car (10 adults) with riders on both sides, from the middle, near either end and at each end */
+static void test_full_car(void)
+{
+    int both[10] = {0, 0, 2, 3, 3, 6, 7, 8, 9, 9};
+    int up[10] = {5, 5, 6, 6, 7, 7, 8, 8, 9, 9};
+    int down[10] = {0, 0, 0, 1, 1, 1, 2, 2, 3, 3};
+    int start;
+    for (start = MIN_FLOOR; start <= MAX_FLOOR; start++)
+        check_drain(start, both, 10);
+    check_drain(4, up, 10);
+    check_drain(4, down, 10);
+    check_drain(0, up, 10);
+    check_drain(9, down, 10);
+}
+
+/* every rider going to the same floor, from below it, above it, and at it */
+static void test_single_floor(void)
+{
+    int same[10] = {6, 6, 6, 6, 6, 6, 6, 6, 6, 6};
+    check_drain(2, same, 10);
+    check_drain(8, same, 10);
+    check_drain(6, same, 10);
+}
+
+/* an empty car goes OFFLINE on its next step with a drain of 0 */
+static void test_empty_car(void)
+{
+    check_drain(5, NULL, 0);
+}
+
+/* a car stopped mid-travel finishes the floor it is moving to before turning for the shorter way */
+static void test_stop_while_travelling(void)
+{
+    Elevator *elv = elevators[0];
+    int dests[10] = {1, 1, 1, 1, 1, 8, 8, 8, 8, 8};
+    int ms;
+    elv->current_floor = elv->next_floor = 5;
+    elv->direction = UP;
+    elevator_start(elv);
+    board(elv, dests, 10);
+    /* heading up: unload nothing, leave for 6 */
+    ms = elevator_advance(elv);
+    CHECK(ms == TIME_BETWEEN_FLOORS && elv->state == UP, "car didn't leave, state %s",
+          ELEVATOR_STATE_STRINGS[elv->state]);
+    elevator_stop(elv);
+    now += ms * (u64) NSEC_PER_MSEC;
+    run_until_waiting(elv);
+    /* from 6: up 2 to 8 and down 7 to 1 beats down 5 to 1 and back up 7 */
+    CHECK(elv->state == OFFLINE && elv->load.count == 0, "car not drained");
+    CHECK(elv->drain_ns == (u64) (TIME_BETWEEN_FLOORS * (1 + 2 + 7) + 2 * TIME_AT_FLOOR) * NSEC_PER_MSEC,
+          "drain while travelling took %llums", (unsigned long long) (elv->drain_ns / NSEC_PER_MSEC));
+}
+
+int main(void)
+{
+    if (passenger_cache_create())
+        return 1;
+    floors = create_floors_array(NUM_FLOORS);
+    elevators = create_elevators_array(1);
+    if (!floors || !elevators)
+        return 1;
+    test_full_car();
+    test_single_floor();
+    test_empty_car();
+    test_stop_while_travelling();
+    free_elevators_array(elevators, num_elevators);
+    free_floors_array(floors, NUM_FLOORS);
+    passenger_cache_destroy();
+    return check_summary("drain_test");
+}
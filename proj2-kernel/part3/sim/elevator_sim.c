@@ -0,0 +1,411 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "elevator.h"
+#include "trace.h"
+
+/**
+ * Userspace simulator for the elevator scheduler. It links the unmodified `elevator_core.c` and implements the
+ * platform hooks from `elevator_platform.h` on a virtual clock. An event loop plays the module's timers: it delivers
+ * arrivals, plays the dispatcher and calls `elevator_advance` for whichever car is due next (moving the clock on when
+ * none is), so a 5 minute stress run takes milliseconds and is fully deterministic for a given seed.
+ *
+ * The default workload replays elevator4_stress_test/producer.c: srand(17), 1M requests issued back to back at t=0,
+ * and `stop_elevator` after 5 minutes. `-i` replays a trace (elevator4_stress_test/trace.h) instead, each request at its
+ * recorded time, and `-o` writes the requests of a run to one.
+ */
+
+#define NS_PER_SEC 1000000000ULL
+
+/* virtual clock and run control */
+static u64 sim_now;                 /* ns since the elevator started */
+static u64 sim_duration;            /* ns until stop_elevator, 0 runs until every request is serviced */
+static int sim_stopping;
+
+/* the module's per car timer */
+typedef struct {
+    Elevator *elv;
+    u64 wake_at;                    /* virtual time the car's next `elevator_advance` is due */
+    int pending;                    /* armed, otherwise the car is waiting for `elevator_resume` (or OFFLINE) */
+} SimCar;
+
+static SimCar sim_cars[MAX_CARS];
+
+/* workload */
+static long sim_num_requests = 1000000;
+static long sim_num_issued;
+static u64 sim_interval;            /* ns between requests, 0 issues them all at once like the producer */
+static u64 sim_next_arrival;
+static int sim_batch;               /* requests per elevator_issue_requests call, 0 issues them one at a time */
+static ElevatorRequest *sim_requests;
+static ElevatorRequestChains sim_chains;
+static double sim_ingest_secs;      /* wall time spent issuing */
+static struct trace sim_trace;      /* mapped `-i` trace, the requests come from it when `sim_trace.records` is set */
+static struct trace_writer sim_record;  /* `-o` trace, written when `sim_record.file` is set */
+
+/* metrics */
+static u64 *sim_waits, *sim_rides;  /* per serviced passenger, in ns */
+static size_t sim_num_serviced, sim_capacity;
+static u64 sim_busy_ns;             /* car time spent not IDLE, summed over the cars */
+static u64 sim_load_ns;             /* integral of load units over the busy time */
+static long sim_dispatched;         /* hall calls assigned to a car */
+
+
+/******************************************************************************/
+
+/* same generator as elevator4_stress_test/producer.c, so a seed gives the same requests (with its 10 floors) */
+static int rnd(int min, int max)
+{
+    return rand() % (max - min + 1) + min;
+}
+
+static int rnd_dest(int start)
+{
+    int chance = rnd(0, 100), ret;
+    /* 70%-ish chance of choose 1 as a destination (if not already on floor 1) */
+    if (chance <= 70 && start != 1)
+        ret = 1;
+    else {
+        do {
+            ret = rnd(2, NUM_FLOORS);
+        } while (ret == start);
+    }
+    return ret;
+}
+
+static double wall_secs(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* the next request, from the trace or the generator */
+static void sim_next_request(int *type, int *start, int *dest)
+{
+    const struct trace_record *r;
+    if (sim_trace.records) {
+        r = &sim_trace.records[sim_num_issued];
+        *type = r->type;
+        *start = r->start;
+        *dest = r->dest;
+        return;
+    }
+    *type = rnd(1, 4);
+    *start = rnd(1, NUM_FLOORS);
+    *dest = rnd_dest(*start);
+}
+
+/* when the request after the one just issued arrives */
+static u64 sim_following_arrival(void)
+{
+    if (sim_trace.records)
+        return sim_num_issued < sim_num_requests ?
+               sim_next_arrival + sim_trace.records[sim_num_issued].delta_us * (u64) NSEC_PER_USEC : sim_next_arrival;
+    return sim_next_arrival + sim_interval;
+}
+
+/* issue every request due by `sim_now`, stamped with the current virtual time */
+static void sim_deliver_arrivals(void)
+{
+    double start_secs = wall_secs();
+    int type, start, dest, n = 0;
+    while (!sim_stopping && sim_num_issued < sim_num_requests && sim_next_arrival <= sim_now) {
+        sim_next_request(&type, &start, &dest);
+        if (sim_record.file)
+            trace_append(&sim_record, sim_now / NSEC_PER_USEC, type, start, dest);
+        if (sim_batch) {
+            sim_requests[n].passenger_type = type;
+            sim_requests[n].start_floor = start;
+            sim_requests[n].destination_floor = dest;
+            if (++n == sim_batch) {
+                elevator_issue_requests(sim_requests, n, &sim_chains);
+                n = 0;
+            }
+        }
+        else {
+            elevator_issue_request(type, start, dest);
+        }
+        sim_num_issued++;
+        sim_next_arrival = sim_following_arrival();
+    }
+    if (n > 0)
+        elevator_issue_requests(sim_requests, n, &sim_chains);
+    sim_ingest_secs += wall_secs() - start_secs;
+}
+
+/* move the clock forward to `until` (the scheduler never jumps past an arrival), accounting each car's busy time */
+static void sim_advance(u64 until)
+{
+    Elevator *elv;
+    int i;
+    for (i = 0; i < num_elevators; i++) {
+        elv = elevators[i];
+        if (elv->state != IDLE && elv->state != OFFLINE) {
+            sim_busy_ns += until - sim_now;
+            sim_load_ns += (until - sim_now) * elv->load.units;
+        }
+    }
+    sim_now = until;
+    if (sim_duration && sim_now >= sim_duration)
+        sim_stopping = 1;
+}
+
+static int sim_arrivals_pending(void)
+{
+    return !sim_stopping && sim_num_issued < sim_num_requests;
+}
+
+/**
+ * the event loop: deliver the arrivals that are due and dispatch their calls, then advance the car that is due soonest
+ * (lowest id on ties) and arm it again. When none is due, move the clock on to the next car or arrival; if every car is
+ * waiting and nothing is left to arrive, the run is over (at the stop time if there is one). Once stopping, every car is
+ * told to `elevator_stop` and the loop runs until they are all OFFLINE
+ * @return: the virtual time the bank was stopped
+ */
+static u64 sim_run_cars(void)
+{
+    SimCar *car, *next;
+    u64 until, stop_ns = 0;
+    int i, ms, offline;
+    for (;;) {
+        if (sim_arrivals_pending() && sim_next_arrival <= sim_now)
+            sim_deliver_arrivals();
+        if (!sim_stopping) {
+            sim_dispatched += elevator_dispatch();
+        }
+        else if (!stop_ns) {
+            stop_ns = sim_now;
+            for (i = 0; i < num_elevators; i++)
+                elevator_stop(elevators[i]);
+        }
+        next = NULL;
+        offline = 0;
+        for (i = 0; i < num_elevators; i++) {
+            car = &sim_cars[i];
+            offline += car->elv->state == OFFLINE;
+            if (car->pending && (!next || car->wake_at < next->wake_at))
+                next = car;
+        }
+        if (offline == num_elevators)
+            return stop_ns;
+        if (next && next->wake_at <= sim_now) {
+            next->pending = 0;
+            ms = elevator_advance(next->elv);
+            if (ms != ELEVATOR_WAIT) {
+                next->pending = 1;
+                next->wake_at = sim_now + ms * (u64) NSEC_PER_MSEC;
+            }
+            continue;
+        }
+        until = next ? next->wake_at : 0;
+        if (sim_arrivals_pending() && (!until || sim_next_arrival < until))
+            until = sim_next_arrival;
+        if (!sim_stopping && sim_duration && (!until || sim_duration < until))
+            until = sim_duration;
+        if (until)
+            sim_advance(until);
+        else
+            sim_stopping = 1;   /* everybody is waiting on calls that will never come */
+    }
+}
+
+
+/******************************************************************************/
+/* platform hooks, see elevator_platform.h */
+
+u64 ktime_get_ns(void)
+{
+    return sim_now;
+}
+
+/* the car got a call (or is stopping) while waiting, or was just started: it is due right away */
+void elevator_resume(Elevator *elv)
+{
+    sim_cars[elv->id].pending = 1;
+    sim_cars[elv->id].wake_at = sim_now;
+}
+
+void elevator_notify(Elevator *elv, ElevatorEvent event, PassengerNode *p)
+{
+    if (event != ELEVATOR_EVENT_ALIGHT)
+        return;
+    if (sim_num_serviced == sim_capacity) {
+        sim_capacity = sim_capacity ? sim_capacity * 2 : 4096;
+        sim_waits = realloc(sim_waits, sim_capacity * sizeof(u64));
+        sim_rides = realloc(sim_rides, sim_capacity * sizeof(u64));
+        if (!sim_waits || !sim_rides) {
+            fprintf(stderr, "elevator_sim: out of memory\n");
+            exit(1);
+        }
+    }
+    sim_waits[sim_num_serviced] = p->boarded_ns - p->issued_ns;
+    sim_rides[sim_num_serviced] = sim_now - p->boarded_ns;
+    sim_num_serviced++;
+}
+
+
+/******************************************************************************/
+
+static int cmp_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64 *) a, y = *(const u64 *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* print mean, p50, p99 and max of `vals` in seconds, sorts `vals` */
+static void print_distribution(const char *name, u64 *vals, size_t n)
+{
+    long double total = 0;
+    size_t i;
+    if (n == 0) {
+        printf("%-14s n/a\n", name);
+        return;
+    }
+    qsort(vals, n, sizeof(u64), cmp_u64);
+    for (i = 0; i < n; i++)
+        total += vals[i];
+    printf("%-14s mean %8.1fs   p50 %8.1fs   p99 %8.1fs   max %8.1fs\n", name,
+           (double) (total / n / NS_PER_SEC), (double) vals[n / 2] / NS_PER_SEC,
+           (double) vals[(n * 99) / 100] / NS_PER_SEC, (double) vals[n - 1] / NS_PER_SEC);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n requests] [-s seed] [-d seconds until stop, 0 = until done] [-r requests/sec] "
+            "[-p policy] [-P (no predictive parking)] [-b requests per issue_requests batch] [-c cars] [-f floors] "
+            "[-t ms between floors] [-T ms at a stop] [-w relaxed FIFO window] [-a ms waited before a head can't be "
+            "passed] [-i trace to replay] [-o trace to write]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    struct timeval wall_start, wall_end;
+    unsigned int seed = 17;
+    const char *policy = NULL, *replay = NULL, *record = NULL;
+    double rate = 0, wall;
+    long waiting = 0;
+    u64 stop_ns, drain_ns;
+    int opt, i, num_cars = 1, park_decisions = 0, park_hits = 0, park_misses = 0, overtakes = 0;
+
+    sim_duration = 5 * 60 * NS_PER_SEC;
+    while ((opt = getopt(argc, argv, "n:s:d:r:p:Pb:c:f:t:T:w:a:i:o:")) != -1) {
+        switch (opt) {
+            case 'n': sim_num_requests = atol(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            case 'd': sim_duration = (u64) (atof(optarg) * NS_PER_SEC); break;
+            case 'r': rate = atof(optarg); break;
+            case 'p': policy = optarg; break;
+            case 'P': elevator_predictive_parking = 0; break;
+            case 'b': sim_batch = atoi(optarg); break;
+            case 'c': num_cars = atoi(optarg); break;
+            case 'f': elevator_num_floors = atoi(optarg); break;
+            case 't': elevator_travel_ms = atoi(optarg); break;
+            case 'T': elevator_stop_ms = atoi(optarg); break;
+            case 'w': elevator_board_window = atoi(optarg); break;
+            case 'a': elevator_board_max_wait_ms = atoi(optarg); break;
+            case 'i': replay = optarg; break;
+            case 'o': record = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (elevator_config_check())
+        return 1;
+    sim_interval = rate > 0 ? (u64) (NS_PER_SEC / rate) : 0;
+    if (sim_batch > 0 && !(sim_requests = calloc(sim_batch, sizeof(ElevatorRequest))))
+        return 1;
+    srand(seed);
+    if (replay) {
+        if (trace_open(&sim_trace, replay)) {
+            fprintf(stderr, "elevator_sim: %s isn't a trace\n", replay);
+            return 1;
+        }
+        sim_num_requests = sim_trace.count;
+        sim_next_arrival = sim_trace.count ? sim_trace.records[0].delta_us * (u64) NSEC_PER_USEC : 0;
+    }
+    if (record && trace_create(&sim_record, record)) {
+        fprintf(stderr, "elevator_sim: can't write %s\n", record);
+        return 1;
+    }
+
+    if (passenger_cache_create())
+        return 1;
+    floors = create_floors_array(NUM_FLOORS);
+    elevators = create_elevators_array(num_cars);
+    if (!floors || !elevators)
+        return 1;
+    for (i = 0; i < num_elevators; i++) {
+        if (policy && elevator_set_policy(elevators[i], policy)) {
+            fprintf(stderr, "elevator_sim: unknown policy %s\n", policy);
+            return 1;
+        }
+        /* start_elevator */
+        sim_cars[i].elv = elevators[i];
+        elevator_start(elevators[i]);
+    }
+
+    gettimeofday(&wall_start, NULL);
+    /* run the bank until the stop time, then stop_elevator: no more requests are taken, but everyone in a car gets
+       delivered */
+    stop_ns = sim_run_cars();
+    drain_ns = sim_now - stop_ns;
+    gettimeofday(&wall_end, NULL);
+
+    for (i = 0; i < NUM_FLOORS; i++)
+        waiting += floors[i]->load.count;
+    wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_usec - wall_start.tv_usec) / 1e6;
+
+    for (i = 0; i < num_elevators; i++) {
+        park_decisions += elevators[i]->park_decisions;
+        park_hits += elevators[i]->park_hits;
+        park_misses += elevators[i]->park_misses;
+        overtakes += elevators[i]->overtakes;
+    }
+
+    printf("policy:            %s, %d car(s)\n", elevators[0]->policy->name, num_elevators);
+    printf("building:          %d floors, %ums between floors, %ums stops\n", NUM_FLOORS, elevator_travel_ms,
+           elevator_stop_ms);
+    if (replay)
+        printf("requests issued:   %ld (trace %s)\n", sim_num_issued, replay);
+    else
+        printf("requests issued:   %ld (seed %u)\n", sim_num_issued, seed);
+    printf("serviced:          %zu\n", sim_num_serviced);
+    printf("left waiting:      %ld (%ld KiB at %zu bytes per passenger)\n", waiting,
+           waiting * (long) sizeof(PassengerNode) / 1024, sizeof(PassengerNode));
+    printf("simulated time:    %.1fs (drain after stop %.1fs), wall time %.3fs\n",
+           (double) sim_now / NS_PER_SEC, (double) drain_ns / NS_PER_SEC, wall);
+    printf("issuing:           %.3fs wall (%.1f M requests/s, %s)\n", sim_ingest_secs,
+           sim_ingest_secs > 0 ? sim_num_issued / sim_ingest_secs / 1e6 : 0.0,
+           sim_batch ? "batched" : "one at a time");
+    printf("throughput:        %.2f passengers/min\n",
+           sim_now ? sim_num_serviced * 60.0 * NS_PER_SEC / sim_now : 0.0);
+    print_distribution("wait time:", sim_waits, sim_num_serviced);
+    print_distribution("ride time:", sim_rides, sim_num_serviced);
+    printf("utilisation:       %.1f%% busy, mean load %.2f/%d units while busy\n",
+           sim_now ? 100.0 * sim_busy_ns / sim_now / num_elevators : 0.0,
+           sim_busy_ns ? (double) sim_load_ns / sim_busy_ns : 0.0, MAX_LOAD_UNITS);
+    printf("parking:           %d decisions, %d/%d hits\n", park_decisions, park_hits, park_hits + park_misses);
+    if (elevator_board_window)
+        printf("boarding:          relaxed FIFO, window %d, max wait %us, %d boarded past the head\n",
+               elevator_board_window, elevator_board_max_wait_ms / 1000, overtakes);
+    else
+        printf("boarding:          FIFO\n");
+    printf("calls dispatched:  %ld\n", sim_dispatched);
+
+    free_elevators_array(elevators, num_elevators);
+    free_floors_array(floors, NUM_FLOORS);
+    passenger_cache_destroy();
+    free(sim_requests);
+    if (replay)
+        trace_close(&sim_trace);
+    if (record && trace_finish(&sim_record)) {
+        fprintf(stderr, "elevator_sim: couldn't finish writing %s\n", record);
+        return 1;
+    }
+    free(sim_waits);
+    free(sim_rides);
+    return 0;
+}
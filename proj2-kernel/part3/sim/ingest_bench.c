@@ -0,0 +1,172 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "elevator.h"
+
+/**
+ * Per call latency of the `issue_request` path with several producers, through elevator_core.c itself (built with
+ * SIM_THREADED, so its mutexes, inboxes and bits are real, see elevator_platform.h):
+ *   mutex -- the old path, every call creates the passenger and takes the start floor's mutex to enqueue it
+ *            (`floor_enqueue_passenger`)
+ *   llist -- the syscall's path, `elevator_issue_request`, which pushes onto the floor's inbox
+ * In both a consumer thread plays the elevator: every `-c` microseconds it drains the inboxes (`floors_drain_inboxes`,
+ * as the dispatcher does), then takes each floor's mutex and dequeues its passengers, holding the lock for `-l`
+ * microseconds per floor like `elevator_load_floor` does while loading.
+ */
+
+#define NS_PER_SEC 1000000000ULL
+
+static int use_llist;
+static long per_thread = 100000;
+static int consume_us = 1000, hold_us = 20;
+static int producers_done;
+static long consumed;
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* platform hooks (see elevator_platform.h), no car runs so nothing is notified or resumed */
+u64 ktime_get_ns(void) { return now_ns(); }
+void elevator_notify(Elevator *elv, ElevatorEvent event, PassengerNode *p) {}
+void elevator_resume(Elevator *elv) {}
+
+static void spin_us(int us)
+{
+    unsigned long long end = now_ns() + us * 1000ULL;
+    while (now_ns() < end)
+        ;
+}
+
+/* one `issue_request`, floors and type 0-indexed, `dest` is never `floor` so every request queues a passenger */
+static void issue(int floor, int type, int dest)
+{
+    PassengerNode *p;
+    if (use_llist)
+        elevator_issue_request(type + 1, floor + 1, dest + 1);
+    else if ((p = passenger_node_create(type, dest)) != NULL)
+        floor_enqueue_passenger(floors[floor], p);
+}
+
+static void *producer(void *arg)
+{
+    unsigned long long *lat = arg, start;
+    unsigned int seed = (unsigned int) (size_t) arg;
+    long i;
+    int floor, type, dest;
+    for (i = 0; i < per_thread; i++) {
+        floor = rand_r(&seed) % NUM_FLOORS;
+        type = rand_r(&seed) % NUM_PASSENGER_TYPES;
+        dest = (floor + 1 + rand_r(&seed) % (NUM_FLOORS - 1)) % NUM_FLOORS;
+        start = now_ns();
+        issue(floor, type, dest);
+        lat[i] = now_ns() - start;
+    }
+    return NULL;
+}
+
+/* dequeue and free everything queued on `floor`, holding its lock for `hold_us` like a load would */
+static void consume_floor(Floor *floor)
+{
+    struct list_head *cur, *dummy;
+    int hall, type;
+    mutex_lock(&floor->lock);
+    for (hall = 0; hall < NUM_HALL_DIRECTIONS; hall++) {
+        for (type = 0; type < NUM_PASSENGER_TYPES; type++) {
+            list_for_each_safe(cur, dummy, &floor->queues[hall][type]) {
+                passenger_node_free(floor_dequeue_passenger(floor, list_entry(cur, PassengerNode, queue)));
+                consumed++;
+            }
+        }
+    }
+    spin_us(hold_us);
+    mutex_unlock(&floor->lock);
+}
+
+static void *consumer(void *arg)
+{
+    int i, done;
+    do {
+        done = __atomic_load_n(&producers_done, __ATOMIC_ACQUIRE);
+        floors_drain_inboxes();
+        for (i = MIN_FLOOR; i <= MAX_FLOOR; i++)
+            consume_floor(floors[i]);
+        usleep(consume_us);
+    } while (!done);
+    return NULL;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s mutex|llist [-t producer threads] [-n requests per thread] "
+            "[-c consumer period us] [-l lock hold us]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t *threads, elevator;
+    unsigned long long *lat, start, elapsed;
+    int opt, i, num_threads = 4;
+    long total;
+
+    if (argc < 2)
+        usage(argv[0]);
+    if (strcmp(argv[1], "llist") == 0)
+        use_llist = 1;
+    else if (strcmp(argv[1], "mutex") != 0)
+        usage(argv[0]);
+    optind = 2;
+    while ((opt = getopt(argc, argv, "t:n:c:l:")) != -1) {
+        switch (opt) {
+            case 't': num_threads = atoi(optarg); break;
+            case 'n': per_thread = atol(optarg); break;
+            case 'c': consume_us = atoi(optarg); break;
+            case 'l': hold_us = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    total = num_threads * per_thread;
+    if (passenger_cache_create())
+        return 1;
+    floors = create_floors_array(NUM_FLOORS);
+    threads = calloc(num_threads, sizeof(pthread_t));
+    lat = calloc(total, sizeof(unsigned long long));
+    if (!floors || !threads || !lat)
+        return 1;
+
+    start = now_ns();
+    pthread_create(&elevator, NULL, consumer, NULL);
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, producer, lat + i * per_thread);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    elapsed = now_ns() - start;
+    __atomic_store_n(&producers_done, 1, __ATOMIC_RELEASE);
+    pthread_join(elevator, NULL);
+
+    qsort(lat, total, sizeof(unsigned long long), cmp_ull);
+    printf("%s: %d producers x %ld requests, consumer every %dus holding each floor %dus\n",
+           argv[1], num_threads, per_thread, consume_us, hold_us);
+    printf("  issue latency  p50 %6llu ns  p99 %8llu ns  p99.9 %8llu ns  max %9llu ns\n",
+           lat[total / 2], lat[total * 99 / 100], lat[total * 999 / 1000], lat[total - 1]);
+    printf("  %.2f M requests/s, %ld consumed\n", total * 1e3 / elapsed, consumed);
+    free_floors_array(floors, NUM_FLOORS);
+    passenger_cache_destroy();
+    free(threads);
+    free(lat);
+    return 0;
+}
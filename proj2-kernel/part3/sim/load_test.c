@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+/**
+ * Checks the fixed point `Load` arithmetic in elevator_core.c against the spec's fractional weights, computed here
+ * with doubles: child 0.5 / 1 unit, adult 1 / 1, bellhop 2 / 2, room service 3 / 2, and a car limit of 15 weight and
+ * 10 units, then with a smaller car in a taller building, and which building configurations are accepted. Links the
+ * core like the simulator does, the platform hooks are stubs since no car runs here.
+ */
+
+static const double SPEC_WEIGHTS[NUM_PASSENGER_TYPES] = {0.5, 1.0, 2.0, 3.0};
+static const int SPEC_UNITS[NUM_PASSENGER_TYPES] = {1, 1, 2, 2};
+
+/******************************************************************************/
+
+/* a shadow of a `Load` computed the obvious way */
+typedef struct {
+    int count, units;
+    double weight;
+    int by_type[NUM_PASSENGER_TYPES];
+    int by_dest[MAX_NUM_FLOORS];
+} SpecLoad;
+
+static void check_matches(const Load *load, const SpecLoad *spec)
+{
+    char got[32], want[32];
+    int i;
+    CHECK(load->count == spec->count, "count %d, want %d", load->count, spec->count);
+    CHECK(load->units == spec->units, "units %d, want %d", load->units, spec->units);
+    CHECK(load->half_weight == (int) (spec->weight * 2), "half weight %d, want %.1f", load->half_weight, spec->weight);
+    /* what /proc shows */
+    snprintf(got, sizeof(got), "%d.%d", LOAD_WEIGHT_WHOLE(load), LOAD_WEIGHT_TENTHS(load));
+    snprintf(want, sizeof(want), "%.1f", spec->weight);
+    CHECK(strcmp(got, want) == 0, "weight printed as %s, want %s", got, want);
+    for (i = 0; i < NUM_PASSENGER_TYPES; i++)
+        CHECK(load->by_type[i] == spec->by_type[i], "by_type[%d] %d, want %d", i, load->by_type[i], spec->by_type[i]);
+    for (i = 0; i < NUM_FLOORS; i++)
+        CHECK(load->by_dest[i] == spec->by_dest[i], "by_dest[%d] %d, want %d", i, load->by_dest[i], spec->by_dest[i]);
+}
+
+static void spec_add(SpecLoad *spec, const PassengerNode *p, int sign)
+{
+    spec->count += sign;
+    spec->units += sign * SPEC_UNITS[p->passenger_type];
+    spec->weight += sign * SPEC_WEIGHTS[p->passenger_type];
+    spec->by_type[p->passenger_type] += sign;
+    spec->by_dest[p->destination_floor] += sign;
+}
+
+static int spec_can_fit(const SpecLoad *spec, const PassengerNode *p)
+{
+    return spec->units + SPEC_UNITS[p->passenger_type] <= MAX_LOAD_UNITS &&
+           spec->weight + SPEC_WEIGHTS[p->passenger_type] <= MAX_LOAD_WEIGHT;
+}
+
+
+/* every type on its own */
+static void test_single_passengers(void)
+{
+    PassengerNode *p;
+    SpecLoad spec;
+    Load load;
+    int type;
+    for (type = CHILD; type <= ROOM_SERVICE; type++) {
+        memset(&load, 0, sizeof(load));
+        memset(&spec, 0, sizeof(spec));
+        p = passenger_node_create(type, type);
+        load_add(&load, p);
+        spec_add(&spec, p, 1);
+        check_matches(&load, &spec);
+        load_sub(&load, p);
+        spec_add(&spec, p, -1);
+        check_matches(&load, &spec);
+        passenger_node_free(p);
+    }
+}
+
+/* the fractional edge cases: odd and even numbers of children, and the limit reached with half units */
+static void test_children(void)
+{
+    PassengerNode *child = passenger_node_create(CHILD, 0), *adult = passenger_node_create(ADULT, 0);
+    SpecLoad spec;
+    Load load;
+    int i;
+    memset(&load, 0, sizeof(load));
+    memset(&spec, 0, sizeof(spec));
+    /* 3 room service = 9 weight / 6 units, then children one at a time up to the 10 unit limit */
+    for (i = 0; i < 3; i++) {
+        PassengerNode rs = {.passenger_type = ROOM_SERVICE, .destination_floor = 1};
+        load_add(&load, &rs);
+        spec_add(&spec, &rs, 1);
+    }
+    for (i = 0; i < 4; i++) {
+        CHECK(load_can_fit(&load, child) == spec_can_fit(&spec, child), "child %d fit", i);
+        load_add(&load, child);
+        spec_add(&spec, child, 1);
+        check_matches(&load, &spec);
+    }
+    /* 11.0 weight, 10 units: full on units even though there is weight left */
+    CHECK(!load_can_fit(&load, child), "child fits at 10 units");
+    load_sub(&load, child);
+    spec_add(&spec, child, -1);
+    /* 10.5 weight, 9 units: one more adult makes 11.5 */
+    CHECK(load_can_fit(&load, adult), "adult doesn't fit at 10.5 / 9");
+
+    /* 4 room service and a child = 12.5 weight / 9 units, then 15.0 / 10 exactly with a fifth room service */
+    memset(&load, 0, sizeof(load));
+    memset(&spec, 0, sizeof(spec));
+    for (i = 0; i < 4; i++) {
+        PassengerNode rs = {.passenger_type = ROOM_SERVICE, .destination_floor = 2};
+        load_add(&load, &rs);
+        spec_add(&spec, &rs, 1);
+    }
+    load_add(&load, child);
+    spec_add(&spec, child, 1);
+    check_matches(&load, &spec);
+    for (i = CHILD; i <= ROOM_SERVICE; i++) {
+        PassengerNode p = {.passenger_type = i, .destination_floor = 3};
+        CHECK(load_can_fit(&load, &p) == spec_can_fit(&spec, &p), "type %d fit at 12.5 / 9", i);
+    }
+    load_sub(&load, child);
+    spec_add(&spec, child, -1);
+    {
+        PassengerNode rs = {.passenger_type = ROOM_SERVICE, .destination_floor = 2};
+        CHECK(load_can_fit(&load, &rs), "room service doesn't fit at 12.0 / 8");
+        load_add(&load, &rs);
+        spec_add(&spec, &rs, 1);
+        check_matches(&load, &spec);
+        CHECK(!load_can_fit(&load, child), "child fits at 15.0 / 10");
+    }
+    passenger_node_free(child);
+    passenger_node_free(adult);
+}
+
+/* random boarding and alighting, the fixed point load has to track the double one exactly */
+static void test_random_sequences(void)
+{
+    PassengerNode *car[64], *p;
+    SpecLoad spec;
+    Load load;
+    int n = 0, i, op;
+    memset(&load, 0, sizeof(load));
+    memset(&spec, 0, sizeof(spec));
+    srand(7);
+    for (op = 0; op < 200000; op++) {
+        if (n > 0 && (rand() % 2 || n == 64)) {
+            i = rand() % n;
+            load_sub(&load, car[i]);
+            spec_add(&spec, car[i], -1);
+            passenger_node_free(car[i]);
+            car[i] = car[--n];
+        }
+        else {
+            p = passenger_node_create(rand() % NUM_PASSENGER_TYPES, rand() % NUM_FLOORS);
+            CHECK(load_can_fit(&load, p) == spec_can_fit(&spec, p), "fit for type %d at %d units, %.1f weight",
+                  p->passenger_type, spec.units, spec.weight);
+            /* board only what fits, like the car, so the limits get exercised */
+            if (load_can_fit(&load, p)) {
+                load_add(&load, p);
+                spec_add(&spec, p, 1);
+                car[n++] = p;
+            }
+            else {
+                passenger_node_free(p);
+            }
+        }
+        check_matches(&load, &spec);
+        CHECK(load.units <= MAX_LOAD_UNITS && load.half_weight <= MAX_LOAD_HALF_WEIGHT, "over the limit");
+    }
+    while (n > 0)
+        passenger_node_free(car[--n]);
+}
+
+/* the limits and geometry come from the module parameters, the arithmetic has to hold for any car that is accepted */
+static void test_configured_car(void)
+{
+    elevator_num_floors = MAX_NUM_FLOORS;
+    elevator_max_load_units = 4;
+    elevator_max_load_weight = 5;
+    CHECK(elevator_config_check() == 0, "%d floors, 4 units, 5 weight rejected", MAX_NUM_FLOORS);
+    test_random_sequences();
+    elevator_num_floors = 10;
+    elevator_max_load_units = 10;
+    elevator_max_load_weight = 15;
+}
+
+/* the configurations the core can't run: too few or too many floors, a car too small for some passenger, no time */
+static void test_config_check(void)
+{
+    CHECK(elevator_config_check() == 0, "the spec's building rejected");
+    elevator_num_floors = 1;
+    CHECK(elevator_config_check() != 0, "1 floor accepted");
+    elevator_num_floors = MAX_NUM_FLOORS + 1;
+    CHECK(elevator_config_check() != 0, "%d floors accepted", MAX_NUM_FLOORS + 1);
+    elevator_num_floors = 10;
+    elevator_max_load_units = 1;
+    CHECK(elevator_config_check() != 0, "1 unit car accepted, a bellhop takes 2");
+    elevator_max_load_units = 2;
+    elevator_max_load_weight = 2;
+    CHECK(elevator_config_check() != 0, "2 weight car accepted, room service weighs 3");
+    elevator_max_load_weight = 3;
+    CHECK(elevator_config_check() == 0, "2 unit, 3 weight car rejected");
+    elevator_max_load_units = 10;
+    elevator_max_load_weight = 15;
+    elevator_time_scale = 0;
+    CHECK(elevator_config_check() != 0, "time scale 0 accepted");
+    elevator_time_scale = 1;
+}
+
+int main(void)
+{
+    if (passenger_cache_create())
+        return 1;
+    test_single_passengers();
+    test_children();
+    test_random_sequences();
+    test_configured_car();
+    test_config_check();
+    passenger_cache_destroy();
+    return check_summary("load_test");
+}
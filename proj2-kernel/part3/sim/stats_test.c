@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+/**
+ * Checks the log2 latency histograms in elevator_core.c: the bucket boundaries, and that the percentiles reported from
+ * the buckets bound the exact ones (computed here by sorting the samples) from above by less than a factor of 2, up to
+ * the open ended last bucket.
+ */
+
+#define MS (1000ULL * 1000ULL)
+
+/* the bucket a single sample of `ns` lands in */
+static int bucket_of(u64 ns)
+{
+    LatencyHistogram h;
+    int i;
+    memset(&h, 0, sizeof(h));
+    latency_histogram_add(&h, ns);
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+        if (h.buckets[i])
+            return i;
+    return -1;
+}
+
+static void test_buckets(void)
+{
+    int i;
+    CHECK(bucket_of(0) == 0, "0ns in bucket %d", bucket_of(0));
+    CHECK(bucket_of(2 * MS - 1) == 0, "1.99ms in bucket %d", bucket_of(2 * MS - 1));
+    for (i = 1; i < LATENCY_BUCKETS; i++) {
+        CHECK(bucket_of((1ULL << i) * MS) == i, "2^%d ms in bucket %d", i, bucket_of((1ULL << i) * MS));
+        CHECK(bucket_of((2ULL << i) * MS - 1) == i, "2^%d ms - 1ns in bucket %d", i + 1, bucket_of((2ULL << i) * MS - 1));
+    }
+    /* everything longer goes in the last bucket, including more ms than fit in 32 bits */
+    CHECK(bucket_of((1ULL << 40) * MS) == LATENCY_BUCKETS - 1, "2^40 ms in bucket %d", bucket_of((1ULL << 40) * MS));
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    u32 x = *(const u32 *) a, y = *(const u32 *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* `n` samples with spread `spread` ms: the counters are exact and the percentiles are within a bucket */
+static void test_percentiles(int n, u32 spread)
+{
+    static const int PERCENTS[] = {1, 50, 90, 99, 100};
+    LatencyHistogram h;
+    u32 *ms = malloc(n * sizeof(u32)), exact, bound;
+    u64 total = 0;
+    int i;
+    memset(&h, 0, sizeof(h));
+    for (i = 0; i < n; i++) {
+        /* skewed towards short waits, like the real ones */
+        ms[i] = (u32) ((u64) rand() % spread * (rand() % spread) / spread);
+        total += ms[i];
+        latency_histogram_add(&h, ms[i] * MS + rand() % MS);
+    }
+    qsort(ms, n, sizeof(u32), cmp_u32);
+    CHECK(h.count == (u32) n, "count %u, want %d", h.count, n);
+    CHECK(h.total_ms == total, "total %llu ms, want %llu", (unsigned long long) h.total_ms, (unsigned long long) total);
+    CHECK(h.max_ms == ms[n - 1], "max %u ms, want %u", h.max_ms, ms[n - 1]);
+    for (i = 0; i < (int) (sizeof(PERCENTS) / sizeof(int)); i++) {
+        exact = ms[((u64) n * PERCENTS[i] + 99) / 100 - 1];
+        bound = latency_histogram_percentile(&h, PERCENTS[i]);
+        /* the last bucket is open ended, all it can tell is the max */
+        if (exact >= 1U << (LATENCY_BUCKETS - 1))
+            CHECK(bound == h.max_ms, "p%d %u ms in the last bucket reported as <= %u ms", PERCENTS[i], exact, bound);
+        else
+            CHECK(exact <= bound && bound <= 2 * exact + 1, "p%d %u ms reported as <= %u ms", PERCENTS[i], exact,
+                  bound);
+    }
+    free(ms);
+}
+
+int main(void)
+{
+    LatencyHistogram empty;
+    memset(&empty, 0, sizeof(empty));
+    CHECK(latency_histogram_percentile(&empty, 50) == 0, "p50 of nothing");
+    test_buckets();
+    srand(7);
+    test_percentiles(1, 1000);
+    test_percentiles(1000, 10);
+    test_percentiles(100000, 300000);
+    test_percentiles(100000, 1 << 30);
+    return check_summary("stats_test");
+}
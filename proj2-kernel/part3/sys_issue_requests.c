@@ -0,0 +1,13 @@
+#include <linux/linkage.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+long (*STUB_issue_requests) (const void __user *, unsigned int) = NULL;
+EXPORT_SYMBOL(STUB_issue_requests);
+asmlinkage long sys_issue_requests(const void __user *requests, unsigned int count)
+{
+    if (STUB_issue_requests)
+        return STUB_issue_requests(requests, count);
+    else
+        return -ENOSYS;
+}
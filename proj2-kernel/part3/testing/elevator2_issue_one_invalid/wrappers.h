@@ -4,6 +4,7 @@
 #define _GNU_SOURCE
 #include <unistd.h>
 #include <sys/syscall.h>
+#include "../issue_requests.h"
 
 #define __NR_START_ELEVATOR 333
 #define __NR_ISSUE_REQUEST 334
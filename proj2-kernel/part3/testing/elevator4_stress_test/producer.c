@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include "wrappers.h"
+#include "trace.h"
 
 int time_set(struct timeval *t, int sec) {
 	t->tv_sec = sec;
@@ -67,6 +69,16 @@ int rnd_dest(int start) {
 
 /******************************************************************************/
 
+void usage(const char *prog) {
+	printf("usage: %s [--batch N] [--no-wait] [--time-scale N] [--record FILE]\n", prog);
+	printf("  --batch N   issue the requests N at a time with issue_requests (default: one issue_request each)\n");
+	printf("  --no-wait   exit once everything is issued instead of waiting out the 5 minutes\n");
+	printf("  --time-scale N  the module was loaded with time_scale=N, wait 5 minutes of building time\n");
+	printf("  --record FILE   write every request and when it was issued to a trace for replay.x\n");
+}
+
+/******************************************************************************/
+
 int main(int argc, char **argv) {
 	const int times = 1000000; 		// 1 million
 	const int total_time = 5 * 60; 	// 5 mins
@@ -75,6 +87,13 @@ int main(int argc, char **argv) {
 	int type;
 	int start;
 	int dest;
+	int batch = 0;
+	int wait = 1;
+	int time_scale = 1;
+	int n = 0;
+	struct elevator_request *requests = NULL;
+	const char *record = NULL;
+	struct trace_writer trace = {0};
 
 	struct timeval t1;
 	struct timeval t2;
@@ -82,26 +101,71 @@ int main(int argc, char **argv) {
 	struct timeval total;
 	struct timeval sleep;
 	
-	if (argc != 1) {
-		printf("wrong number of args\n");
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			batch = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--no-wait") == 0)
+			wait = 0;
+		else if (strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+			time_scale = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			record = argv[++i];
+		else {
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (batch > 0) {
+		requests = malloc(batch * sizeof(struct elevator_request));
+		if (!requests)
+			return -1;
+	}
+	if (record && trace_create(&trace, record)) {
+		printf("can't write %s\n", record);
 		return -1;
 	}
 	
 	srand(17); //fixed to ensure everyone gets the same set of requests
-	time_set(&total, total_time);
+	time_set(&total, total_time / time_scale);
+	total.tv_usec = (total_time % time_scale) * 1000000L / time_scale;
 	
 	gettimeofday(&t1, NULL);	
 	for (i = 0; i < times; i++) {
 		type = rnd(1, 4); 
 		start = rnd(1, 10); 
 		dest = rnd_dest(start); 
-		issue_request(type, start, dest);
+		if (record) {
+			/* the building time it is issued at, or added to the batch */
+			gettimeofday(&t2, NULL);
+			time_diff(&elapsed, &t2, &t1);
+			trace_append(&trace, (elapsed.tv_sec * 1000000ULL + elapsed.tv_usec) * time_scale, type, start, dest);
+		}
+		if (!batch) {
+			issue_request(type, start, dest);
+			continue;
+		}
+		requests[n].type = type;
+		requests[n].start = start;
+		requests[n].dest = dest;
+		if (++n == batch) {
+			issue_requests(requests, n);
+			n = 0;
+		}
 	}
+	if (n > 0)
+		issue_requests(requests, n);
 	gettimeofday(&t2, NULL);
 	
 	time_diff(&elapsed, &t2, &t1);
-	if (time_diff(&sleep, &total, &elapsed) == 0)
+	printf("issued %d requests %s in %ld.%06lds (%.0f requests/s)\n", times,
+	       batch ? "in batches" : "one at a time", elapsed.tv_sec, elapsed.tv_usec,
+	       times / (elapsed.tv_sec + elapsed.tv_usec / 1e6));
+	if (record && trace_finish(&trace))
+		printf("couldn't finish writing %s\n", record);
+	if (wait && time_diff(&sleep, &total, &elapsed) == 0)
 		time_sleep(&sleep);
 
+	free(requests);
+
 	return 0;
 }
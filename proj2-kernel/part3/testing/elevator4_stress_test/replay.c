@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wrappers.h"
+#include "trace.h"
+
+/*
+ * Replays a trace (see trace.h) through issue_request with its timing: every request is issued when its building time
+ * comes up, divided by --time-scale. Open loop, a replay that falls behind issues at once without moving the
+ * requests after it, and the report says how far behind it got.
+ */
+
+#define NS_PER_SEC 1000000000ULL
+#define LATE_NS 1000000		/* issued more than 1ms after its time counts as late */
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns) {
+	struct timespec ts = {ns / NS_PER_SEC, ns % NS_PER_SEC};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+}
+
+void usage(const char *prog) {
+	printf("usage: %s TRACE [--time-scale N] [--batch N]\n", prog);
+	printf("  --time-scale N  the module was loaded with time_scale=N, replay N times faster\n");
+	printf("  --batch N       issue up to N requests that are due together with one issue_requests\n");
+}
+
+int main(int argc, char **argv) {
+	struct trace trace;
+	struct elevator_request *requests = NULL;
+	const struct trace_record *r;
+	const char *path = NULL;
+	uint64_t i, start_ns, due_us = 0, due, now, behind, max_behind = 0, total_behind = 0;
+	long late = 0, invalid = 0;
+	int time_scale = 1, batch = 0, n, a, ret;
+	double elapsed;
+
+	for (a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "--time-scale") == 0 && a + 1 < argc && atoi(argv[a + 1]) > 0)
+			time_scale = atoi(argv[++a]);
+		else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc && atoi(argv[a + 1]) > 0)
+			batch = atoi(argv[++a]);
+		else if (argv[a][0] != '-' && !path)
+			path = argv[a];
+		else {
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (!path) {
+		usage(argv[0]);
+		return -1;
+	}
+	if (trace_open(&trace, path)) {
+		printf("%s isn't a trace\n", path);
+		return -1;
+	}
+	if (batch && !(requests = malloc(batch * sizeof(struct elevator_request))))
+		return -1;
+
+	start_ns = now_ns();
+	for (i = 0; i < trace.count; i += n) {
+		r = &trace.records[i];
+		due_us += r->delta_us;
+		due = start_ns + due_us * 1000 / time_scale;
+		now = now_ns();
+		if (now < due) {
+			sleep_until(due);
+			now = due;
+		}
+		behind = now - due;
+		if (!batch) {
+			invalid += issue_request(r->type, r->start, r->dest) != 0;
+			n = 1;
+		}
+		else {
+			/* this one, and those after it with the same time */
+			for (n = 0; n < batch && i + n < trace.count && (n == 0 || r[n].delta_us == 0); n++) {
+				requests[n].type = r[n].type;
+				requests[n].start = r[n].start;
+				requests[n].dest = r[n].dest;
+			}
+			ret = issue_requests(requests, n);
+			invalid += ret < 0 ? n : ret;
+		}
+		late += behind > LATE_NS ? n : 0;
+		total_behind += behind * n;
+		if (behind > max_behind)
+			max_behind = behind;
+	}
+	elapsed = (now_ns() - start_ns) / 1e9;
+
+	printf("replayed %llu requests from %s in %.3fs (%.0f requests/s, %s), %ld invalid\n",
+	       (unsigned long long) trace.count, path, elapsed, trace.count / elapsed,
+	       batch ? "in batches" : "one at a time", invalid);
+	printf("trace spans %.3fs of building time (%.3fs at x%d)\n", due_us / 1e6, due_us / 1e6 / time_scale,
+	       time_scale);
+	printf("behind schedule: %ld late by more than 1ms, mean %.1fus, max %.1fus\n", late,
+	       trace.count ? total_behind / 1e3 / trace.count : 0, max_behind / 1e3);
+
+	trace_close(&trace);
+	free(requests);
+	return 0;
+}
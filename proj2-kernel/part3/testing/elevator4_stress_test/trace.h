@@ -0,0 +1,114 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Binary trace of elevator requests: a 16 byte header, then one 8 byte record per request in the order they were
+ * issued, in host byte order. Written by `producer.x --record` and `elevator_sim.x -o`, replayed by `replay.x` through
+ * issue_request and by `elevator_sim.x -i`. Readers map the file instead of reading it, so a trace of 100M requests
+ * (800 MB) starts replaying at once and each request costs a load from the mapping.
+ */
+
+#define TRACE_MAGIC 0x43525445		/* "ETRC" */
+#define TRACE_VERSION 1
+
+struct trace_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;		/* sizeof(struct trace_record) */
+	uint64_t count;			/* records that follow */
+};
+
+struct trace_record {
+	uint32_t delta_us;		/* building time since the previous request (the first: since the start), in us */
+	uint8_t type;			/* the arguments of issue_request, floors from 1 */
+	uint8_t start;
+	uint8_t dest;
+	uint8_t reserved;		/* 0 */
+};
+
+/* a mapped trace */
+struct trace {
+	void *map;
+	size_t size;
+	const struct trace_record *records;
+	uint64_t count;
+};
+
+struct trace_writer {
+	FILE *file;
+	uint64_t count;
+	uint64_t last_us;		/* building time of the last record */
+};
+
+/* map the trace at `path`, returns 0 or -1 if it can't be opened or isn't a trace */
+static inline int trace_open(struct trace *t, const char *path) {
+	const struct trace_header *h;
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || st.st_size < (off_t) sizeof(*h)) {
+		close(fd);
+		return -1;
+	}
+	t->size = st.st_size;
+	t->map = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (t->map == MAP_FAILED)
+		return -1;
+	h = t->map;
+	if (h->magic != TRACE_MAGIC || h->version != TRACE_VERSION || h->record_size != sizeof(struct trace_record) ||
+	    h->count > (t->size - sizeof(*h)) / sizeof(struct trace_record)) {
+		munmap(t->map, t->size);
+		return -1;
+	}
+	/* replays read it front to back once: read ahead, and drop the pages behind */
+	madvise(t->map, t->size, MADV_SEQUENTIAL);
+	t->records = (const struct trace_record *) (h + 1);
+	t->count = h->count;
+	return 0;
+}
+
+static inline void trace_close(struct trace *t) {
+	munmap(t->map, t->size);
+}
+
+/* start a trace at `path`, the header's count is filled in by trace_finish */
+static inline int trace_create(struct trace_writer *w, const char *path) {
+	struct trace_header h = {TRACE_MAGIC, TRACE_VERSION, sizeof(struct trace_record), 0};
+	w->file = fopen(path, "wb");
+	w->count = 0;
+	w->last_us = 0;
+	if (!w->file)
+		return -1;
+	setvbuf(w->file, NULL, _IOFBF, 1 << 20);
+	return fwrite(&h, sizeof(h), 1, w->file) == 1 ? 0 : -1;
+}
+
+/**
+ * add a request issued at `time_us` of building time from the start (one before the last counts as the same time). A
+ * gap over 71 minutes doesn't fit the 32 bit delta and is shortened to the longest that does
+ */
+static inline int trace_append(struct trace_writer *w, uint64_t time_us, int type, int start, int dest) {
+	struct trace_record r = {0, type, start, dest, 0};
+	uint64_t delta = time_us > w->last_us ? time_us - w->last_us : 0;
+	r.delta_us = delta > UINT32_MAX ? UINT32_MAX : delta;
+	w->last_us += r.delta_us;
+	w->count++;
+	return fwrite(&r, sizeof(r), 1, w->file) == 1 ? 0 : -1;
+}
+
+static inline int trace_finish(struct trace_writer *w) {
+	struct trace_header h = {TRACE_MAGIC, TRACE_VERSION, sizeof(struct trace_record), w->count};
+	int ret = fseek(w->file, 0, SEEK_SET) || fwrite(&h, sizeof(h), 1, w->file) != 1;
+	return fclose(w->file) || ret ? -1 : 0;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Reads the binary event stream of /dev/elevator_events.
+ *   ./events.x          print every event as it happens
+ *   ./events.x --stats  print the wait (issue to board) and ride (board to alight) time of every passenger
+ *                       delivered, and a summary once the elevator goes OFFLINE
+ */
+
+#define EVENTS_DEV "/dev/elevator_events"
+#define BATCH 256
+
+/* same layout as `ElevatorEventRecord` in elevator_module.c */
+struct elevator_event {
+	uint64_t time_ns;
+	uint64_t since_ns;	/* BOARD: when the request was issued, ALIGHT: when the passenger boarded */
+	uint32_t passenger_id;	/* LOST: number of records dropped */
+	uint8_t event;
+	uint8_t state;
+	uint8_t floor;		/* 0-indexed */
+	uint8_t passenger_type;
+	uint8_t destination_floor;
+	uint8_t car;		/* 0-indexed */
+	uint8_t reserved[6];
+};
+
+enum { EVENT_STATE, EVENT_ARRIVE, EVENT_BOARD, EVENT_ALIGHT, EVENT_LOST = 0xff };
+enum { OFFLINE, IDLE, LOADING, UP, DOWN };
+
+static const char *STATES[] = {"OFFLINE", "IDLE", "LOADING", "UP", "DOWN"};
+static const char *TYPES[] = {"child", "adult", "bellhop", "room service"};
+
+static double secs(uint64_t ns) {
+	return ns / 1e9;
+}
+
+static void print_event(const struct elevator_event *e) {
+	printf("%12.3f  ", secs(e->time_ns));
+	if (e->event != EVENT_LOST)
+		printf("car %d  ", e->car + 1);
+	switch (e->event) {
+	case EVENT_STATE:
+		printf("state   %s at floor %d\n", STATES[e->state], e->floor + 1);
+		break;
+	case EVENT_ARRIVE:
+		printf("arrive  floor %d\n", e->floor + 1);
+		break;
+	case EVENT_BOARD:
+		printf("board   #%u %s at floor %d to %d, waited %.1fs\n", e->passenger_id, TYPES[e->passenger_type],
+		       e->floor + 1, e->destination_floor + 1, secs(e->time_ns - e->since_ns));
+		break;
+	case EVENT_ALIGHT:
+		printf("alight  #%u %s at floor %d, rode %.1fs\n", e->passenger_id, TYPES[e->passenger_type],
+		       e->floor + 1, secs(e->time_ns - e->since_ns));
+		break;
+	case EVENT_LOST:
+		printf("lost    %u events\n", e->passenger_id);
+		break;
+	}
+}
+
+int main(int argc, char **argv) {
+	struct elevator_event events[BATCH];
+	struct pollfd pfd;
+	double total_wait = 0, total_ride = 0, max_wait = 0;
+	long boarded = 0, alighted = 0, lost = 0;
+	unsigned long running = 0;	/* cars seen running, --stats ends when the last goes OFFLINE */
+	int stats = 0, done = 0, fd, i, n;
+
+	if (argc == 2 && strcmp(argv[1], "--stats") == 0)
+		stats = 1;
+	else if (argc != 1) {
+		printf("usage: %s [--stats]\n", argv[0]);
+		return -1;
+	}
+	fd = open(EVENTS_DEV, O_RDONLY);
+	if (fd < 0) {
+		perror(EVENTS_DEV);
+		return -1;
+	}
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (!done) {
+		if (poll(&pfd, 1, -1) < 0) {
+			perror("poll");
+			break;
+		}
+		n = read(fd, events, sizeof(events));
+		if (n < 0) {
+			perror("read");
+			break;
+		}
+		for (i = 0; i < n / (int) sizeof(struct elevator_event); i++) {
+			struct elevator_event *e = &events[i];
+			if (!stats) {
+				print_event(e);
+				continue;
+			}
+			if (e->event != EVENT_LOST && e->state != OFFLINE)
+				running |= 1UL << e->car;
+			if (e->event == EVENT_BOARD) {
+				double wait = secs(e->time_ns - e->since_ns);
+				total_wait += wait;
+				if (wait > max_wait)
+					max_wait = wait;
+				boarded++;
+			}
+			else if (e->event == EVENT_ALIGHT) {
+				total_ride += secs(e->time_ns - e->since_ns);
+				alighted++;
+				print_event(e);
+			}
+			else if (e->event == EVENT_LOST)
+				lost += e->passenger_id;
+			else if (e->event == EVENT_STATE && e->state == OFFLINE) {
+				running &= ~(1UL << e->car);
+				done = !running;
+			}
+		}
+	}
+	if (stats) {
+		printf("boarded %ld, mean wait %.1fs, max wait %.1fs\n", boarded,
+		       boarded ? total_wait / boarded : 0, max_wait);
+		printf("delivered %ld, mean ride %.1fs, %ld events lost\n", alighted,
+		       alighted ? total_ride / alighted : 0, lost);
+	}
+	close(fd);
+	return 0;
+}
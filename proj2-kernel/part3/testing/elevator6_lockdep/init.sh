@@ -0,0 +1,38 @@
+#!/bin/sh
+# init of the lockdep/KCSAN test VM: load the module 100x fast with 4 cars, then run every path that takes a lock at
+# once: producers issuing one at a time and in batches, /proc readers, policy switches through /proc, stats resets,
+# an event reader, start and stop. Prints the lockdep counters and powers off, `make check` reads the console log.
+
+mount -t proc proc /proc
+mount -t sysfs sysfs /sys
+mount -t devtmpfs devtmpfs /dev
+
+insmod /elevator.ko cars=4 time_scale=100 board_window=4 || poweroff -f
+
+# 4 /proc readers, one switching the policy every second and one resetting the stats
+for i in 1 2 3 4; do
+	(while true; do cat /proc/elevator /proc/elevator_stats > /dev/null; done) &
+done
+(while true; do for p in scan look ssf lobby; do echo $p > /proc/elevator; sleep 1; done; done) &
+(while true; do echo reset > /proc/elevator_stats; sleep 2; done) &
+events.x --stats > /tmp/events.log &
+
+# start and stop twice from two processes at once, only one of each may win
+consumer.x --start & consumer.x --start
+wait $!
+producer.x --time-scale 100 & p1=$!
+producer.x --time-scale 100 & p2=$!
+producer.x --time-scale 100 --batch 64 & p3=$!
+producer.x --time-scale 100 --batch 4096
+wait $p1 $p2 $p3
+consumer.x --stop & consumer.x --stop
+wait $!
+
+# the cars drain on their own after stop_elevator
+while grep -E "State:" /proc/elevator | grep -qv OFFLINE; do sleep 1; done
+tail -n 3 /tmp/events.log
+cat /proc/lockdep_stats 2>/dev/null | grep -E "debug_locks|dependency chains|direct dependencies"
+rmmod elevator
+dmesg | grep -iE "elevator|lockdep|kcsan"
+echo "elevator6: done"
+poweroff -f
@@ -0,0 +1,446 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wrappers.h"
+
+/*
+ * Load generator for the elevator module: N producer threads issue requests at a target rate with one of three
+ * arrival models, time every issue_request, and print a throughput/latency report with the module's own numbers.
+ *   poisson  every thread's requests arrive with exponential gaps, floors as in the stress producer
+ *   bursty   groups of requests (mean --burst) arrive together, the groups with exponential gaps, same mean rate
+ *   lobby    a morning peak: the rate rises from 0 to twice the target halfway through and falls back, and 80% of
+ *            the requests start at floor 1 going up
+ * Closed loop (default) a thread waits out its gap after each call returns, so a slow call delays what follows.
+ * Open loop (--open-loop) the arrival times are fixed up front and a thread that falls behind issues at once, and
+ * the response time (arrival to return) is reported next to the call's own latency.
+ * Rates and durations are in building time, divided by --time-scale like the module's time_scale.
+ */
+
+#define NS_PER_SEC 1000000000ULL
+#define BUCKETS 48	/* log2 ns: [0, 2) [2, 4) [4, 8) ... */
+#define LOBBY 1
+#define STATS_TYPES 4
+#define STATS_BUCKETS 20
+
+enum model { POISSON, BURSTY, LOBBY_PEAK };
+static const char *MODELS[] = {"poisson", "bursty", "lobby"};
+static const char *TYPES[] = {"CHILD", "ADULT", "BELLHOP", "ROOM_SERVICE"};
+
+struct histogram {
+	uint64_t buckets[BUCKETS];
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+struct producer {
+	pthread_t thread;
+	uint64_t rng;
+	long issued;
+	long rejected;		/* issue_request returned non-zero */
+	long late;		/* open loop: issued more than 1ms after its arrival time */
+	struct histogram service;	/* the syscall, call to return */
+	struct histogram response;	/* open loop: arrival time to return */
+};
+
+static int threads = 4;
+static double rate = 2;		/* requests per second of building time, all threads */
+static double duration = 300;	/* seconds of building time */
+static enum model model = POISSON;
+static double burst = 8;
+static int open_loop;
+static int time_scale = 1;
+static unsigned int seed = 17;
+static uint64_t start_ns;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns) {
+	struct timespec ts = {ns / NS_PER_SEC, ns % NS_PER_SEC};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+		;
+}
+
+/* building seconds from the start to wall clock ns */
+static uint64_t wall_ns(double building) {
+	return start_ns + (uint64_t) (building * NS_PER_SEC / time_scale);
+}
+
+/******************************************************************************/
+
+/* xorshift64*, one per thread, so the threads don't share rand()'s state */
+static uint64_t rnd_next(uint64_t *s) {
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+	return *s * 2685821657736338717ULL;
+}
+
+/* uniform in (0, 1] */
+static double rnd_unit(uint64_t *s) {
+	return ((rnd_next(s) >> 11) + 1) / 9007199254740992.0;
+}
+
+static int rnd(uint64_t *s, int min, int max) {
+	return rnd_next(s) % (max - min + 1) + min;
+}
+
+static double rnd_exp(uint64_t *s, double per_sec) {
+	return -log(rnd_unit(s)) / per_sec;
+}
+
+/* the stress producer's destinations: 70%-ish to floor 1, the rest uniform over the others */
+static int rnd_dest(uint64_t *s, int start) {
+	int ret;
+	if (rnd(s, 0, 100) <= 70 && start != LOBBY)
+		return LOBBY;
+	do {
+		ret = rnd(s, 2, 10);
+	} while (ret == start);
+	return ret;
+}
+
+static void rnd_request(uint64_t *s, int *type, int *start, int *dest) {
+	*type = rnd(s, 1, 4);
+	if (model == LOBBY_PEAK && rnd(s, 1, 100) <= 80) {
+		*start = LOBBY;
+		*dest = rnd(s, 2, 10);
+		return;
+	}
+	*start = rnd(s, 1, 10);
+	*dest = rnd_dest(s, *start);
+}
+
+/******************************************************************************/
+
+static int histogram_bucket(uint64_t ns) {
+	int bucket = ns < 2 ? 0 : 63 - __builtin_clzll(ns);
+	return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+static void histogram_add(struct histogram *h, uint64_t ns) {
+	h->buckets[histogram_bucket(ns)]++;
+	h->count++;
+	h->total_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+static void histogram_merge(struct histogram *into, const struct histogram *h) {
+	int i;
+	for (i = 0; i < BUCKETS; i++)
+		into->buckets[i] += h->buckets[i];
+	into->count += h->count;
+	into->total_ns += h->total_ns;
+	if (h->max_ns > into->max_ns)
+		into->max_ns = h->max_ns;
+}
+
+/* the upper end of the smallest bucket that covers `percent` of the samples, as latency_histogram_percentile */
+static uint64_t histogram_percentile(const struct histogram *h, double percent) {
+	uint64_t seen = 0, rank = (uint64_t) ceil(h->count * percent / 100);
+	int i;
+	for (i = 0; i < BUCKETS - 1; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			return (2ULL << i) - 1 < h->max_ns ? (2ULL << i) - 1 : h->max_ns;
+	}
+	return h->max_ns;
+}
+
+static void histogram_print(const char *name, const struct histogram *h) {
+	int i, last = 0;
+	if (!h->count)
+		return;
+	printf("%-10s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f  ", name, (unsigned long long) h->count,
+	       h->total_ns / 1e3 / h->count, histogram_percentile(h, 50) / 1e3, histogram_percentile(h, 99) / 1e3,
+	       histogram_percentile(h, 99.9) / 1e3, h->max_ns / 1e3);
+	for (i = 0; i < BUCKETS; i++)
+		if (h->buckets[i])
+			last = i;
+	for (i = 0; i <= last; i++)
+		printf(" %llu", (unsigned long long) h->buckets[i]);
+	printf("\n");
+}
+
+/******************************************************************************/
+
+/* the next arrival after `t` (building seconds) for one thread's share of the rate, 0 or more requests at once */
+static double next_arrival(struct producer *p, double t, int *left_in_burst) {
+	double per_thread = rate / threads;
+	switch (model) {
+	case BURSTY:
+		if (*left_in_burst > 0) {
+			(*left_in_burst)--;
+			return t;
+		}
+		/* geometric group size with mean `burst`, this request is the first of it */
+		*left_in_burst = burst > 1 ? (int) floor(log(rnd_unit(&p->rng)) / log(1 - 1 / burst)) : 0;
+		return t + rnd_exp(&p->rng, per_thread / burst);
+	case LOBBY_PEAK:
+		/* thinning: candidates at the peak rate, kept in proportion to the triangle's height at their time */
+		do {
+			t += rnd_exp(&p->rng, 2 * per_thread);
+		} while (t < duration && rnd_unit(&p->rng) > 1 - fabs(2 * t / duration - 1));
+		return t;
+	default:
+		return t + rnd_exp(&p->rng, per_thread);
+	}
+}
+
+static void *produce(void *arg) {
+	struct producer *p = arg;
+	int type, start, dest, left_in_burst = 0;
+	double arrival = next_arrival(p, 0, &left_in_burst);
+	uint64_t due, call, ret;
+
+	while (arrival < duration) {
+		due = wall_ns(arrival);
+		sleep_until(due);
+		rnd_request(&p->rng, &type, &start, &dest);
+		call = now_ns();
+		p->rejected += issue_request(type, start, dest) != 0;
+		ret = now_ns();
+		p->issued++;
+		histogram_add(&p->service, ret - call);
+		if (open_loop) {
+			histogram_add(&p->response, ret - due);
+			p->late += call - due > 1000000;
+			arrival = next_arrival(p, arrival, &left_in_burst);
+		}
+		else
+			arrival = next_arrival(p, (ret - start_ns) * (double) time_scale / NS_PER_SEC, &left_in_burst);
+	}
+	return NULL;
+}
+
+/******************************************************************************/
+
+/* the first `label` line of /proc/elevator, the bank's (-1 when the module isn't loaded) */
+static long proc_elevator_value(const char *label) {
+	char line[256];
+	long value = -1;
+	FILE *f = fopen("/proc/elevator", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (strncmp(line, label, strlen(label)) == 0) {
+			value = strtol(line + strlen(label), NULL, 10);
+			break;
+		}
+	fclose(f);
+	return value;
+}
+
+static int cars_running(void) {
+	char line[256];
+	int running = 0;
+	FILE *f = fopen("/proc/elevator", "r");
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f))
+		if (strncmp(line, "State:", 6) == 0 && !strstr(line, "OFFLINE"))
+			running++;
+	fclose(f);
+	return running;
+}
+
+static int stats_reset(void) {
+	FILE *f = fopen("/proc/elevator_stats", "w");
+	if (!f)
+		return -1;
+	fputs("reset\n", f);
+	return fclose(f);
+}
+
+/* sums of the per-type rows of one /proc/elevator_stats table, buckets in ms: [0, 2) [2, 4) [4, 8) ... */
+struct module_stats {
+	unsigned long count[STATS_TYPES];
+	unsigned long mean_ms[STATS_TYPES];
+	unsigned long p99_ms[STATS_TYPES];
+	unsigned long buckets[STATS_BUCKETS];
+	unsigned long total;
+	unsigned long long total_ms;
+};
+
+/* the wait (0) and ride (1) tables of /proc/elevator_stats, by passenger type */
+static int module_stats_read(struct module_stats *stats) {
+	char line[512], name[16];
+	unsigned long count, mean, p50, p99, max, bucket;
+	int table = -1, i, type, num, used, at;
+	FILE *f = fopen("/proc/elevator_stats", "r");
+	if (!f)
+		return -1;
+	memset(stats, 0, 2 * sizeof(*stats));
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "Wait", 4) == 0 || strncmp(line, "Ride", 4) == 0) {
+			table = line[0] == 'R';
+			continue;
+		}
+		if (table < 0 || sscanf(line, "%15s %d %lu %lu %lu %lu %lu%n", name, &num, &count, &mean, &p50, &p99, &max,
+		                        &at) != 7)
+			continue;
+		for (type = 0; type < STATS_TYPES && strcmp(name, TYPES[type]) != 0; type++)
+			;
+		if (type == STATS_TYPES)
+			continue;
+		stats[table].count[type] = count;
+		stats[table].mean_ms[type] = mean;
+		stats[table].p99_ms[type] = p99;
+		stats[table].total += count;
+		stats[table].total_ms += (unsigned long long) mean * count;
+		for (i = 0; i < STATS_BUCKETS && sscanf(line + at, "%lu%n", &bucket, &used) == 1; i++, at += used)
+			stats[table].buckets[i] += bucket;
+	}
+	fclose(f);
+	return 0;
+}
+
+static unsigned long module_stats_percentile(const struct module_stats *s, int percent) {
+	unsigned long seen = 0, rank = (s->total * percent + 99) / 100;
+	int i;
+	for (i = 0; i < STATS_BUCKETS; i++) {
+		seen += s->buckets[i];
+		if (seen >= rank)
+			return (2UL << i) - 1;
+	}
+	return 0;
+}
+
+static void module_stats_print(const char *title, const struct module_stats *s) {
+	int type;
+	printf("%s\n", title);
+	for (type = 0; type < STATS_TYPES; type++)
+		if (s->count[type])
+			printf("  %-12s %8lu passengers, mean %6.1fs, p99 <=%6.1fs\n", TYPES[type], s->count[type],
+			       s->mean_ms[type] / 1e3, s->p99_ms[type] / 1e3);
+	if (s->total)
+		printf("  %-12s %8lu passengers, mean %6.1fs, p50 <=%6.1fs, p99 <=%6.1fs\n", "all", s->total,
+		       s->total_ms / 1e3 / s->total, module_stats_percentile(s, 50) / 1e3,
+		       module_stats_percentile(s, 99) / 1e3);
+}
+
+/******************************************************************************/
+
+void usage(const char *prog) {
+	printf("usage: %s [--threads N] [--rate R] [--duration S] [--model poisson|bursty|lobby] [--burst N]\n", prog);
+	printf("          [--open-loop] [--seed N] [--time-scale N] [--stop]\n");
+	printf("  --threads N     producer threads (default 4)\n");
+	printf("  --rate R        requests per second of building time, all threads together (default 2)\n");
+	printf("  --duration S    seconds of building time to issue for (default 300)\n");
+	printf("  --model M       arrival model (default poisson)\n");
+	printf("  --burst N       mean requests per group for --model bursty (default 8)\n");
+	printf("  --open-loop     issue on a fixed schedule however long the calls take\n");
+	printf("  --seed N        seed of the threads' generators (default 17)\n");
+	printf("  --time-scale N  the module was loaded with time_scale=N\n");
+	printf("  --stop          stop_elevator once everything is issued and wait for the cars to drain\n");
+}
+
+int main(int argc, char **argv) {
+	struct producer *producers;
+	struct histogram service = {0}, response = {0};
+	struct module_stats stats[2];
+	long issued = 0, rejected = 0, late = 0, serviced_before, serviced, dispatched;
+	int stop = 0, i;
+	double elapsed, building;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0)
+			rate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0)
+			duration = atof(argv[++i]);
+		else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+			for (model = POISSON; model <= LOBBY_PEAK && strcmp(argv[i + 1], MODELS[model]) != 0; model++)
+				;
+			if (model > LOBBY_PEAK) {
+				usage(argv[0]);
+				return -1;
+			}
+			i++;
+		}
+		else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 1)
+			burst = atof(argv[++i]);
+		else if (strcmp(argv[i], "--open-loop") == 0)
+			open_loop = 1;
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+			time_scale = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--stop") == 0)
+			stop = 1;
+		else {
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	producers = calloc(threads, sizeof(struct producer));
+	if (!producers)
+		return -1;
+
+	if (stats_reset())
+		printf("couldn't reset /proc/elevator_stats, its numbers include earlier runs\n");
+	serviced_before = proc_elevator_value("Num serviced:");
+	printf("%d threads, %s arrivals at %.2f requests/s for %.0fs of building time (x%d), %s loop\n", threads,
+	       MODELS[model], rate, duration, time_scale, open_loop ? "open" : "closed");
+
+	start_ns = now_ns();
+	for (i = 0; i < threads; i++) {
+		producers[i].rng = (seed + 1) * 0x9e3779b97f4a7c15ULL + i * 0xbf58476d1ce4e5b9ULL;
+		if (pthread_create(&producers[i].thread, NULL, produce, &producers[i])) {
+			printf("couldn't start thread %d\n", i);
+			return -1;
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(producers[i].thread, NULL);
+		issued += producers[i].issued;
+		rejected += producers[i].rejected;
+		late += producers[i].late;
+		histogram_merge(&service, &producers[i].service);
+		histogram_merge(&response, &producers[i].response);
+	}
+	elapsed = (now_ns() - start_ns) / 1e9;
+	printf("issued %ld requests in %.3fs (%.1f requests/s, %.2f/s of building time), %ld rejected\n", issued, elapsed,
+	       issued / elapsed, issued / (elapsed * time_scale), rejected);
+	if (open_loop)
+		printf("%ld requests (%.1f%%) issued more than 1ms behind schedule\n", late,
+		       issued ? 100.0 * late / issued : 0);
+
+	printf("\nissue_request latency (us)\n%-10s %10s %10s %10s %10s %10s %10s  %s\n", "", "count", "mean",
+	       "p50 <=", "p99 <=", "p99.9 <=", "max", "buckets: <2ns [2,4) [4,8) ...");
+	histogram_print("call", &service);
+	if (open_loop)
+		histogram_print("response", &response);
+
+	if (stop) {
+		stop_elevator();
+		while (cars_running())
+			sleep_until(now_ns() + NS_PER_SEC / 10);
+	}
+	building = (now_ns() - start_ns) * (double) time_scale / NS_PER_SEC;
+	serviced = proc_elevator_value("Num serviced:");
+	dispatched = proc_elevator_value("Calls dispatched:");
+	if (serviced < 0 || module_stats_read(stats)) {
+		printf("\n/proc/elevator isn't there, is the module loaded?\n");
+		free(producers);
+		return -1;
+	}
+	printf("\nmodule, %.0fs of building time%s\n", building, stop ? " including the drain" : "");
+	printf("  serviced %ld (%.1f/min), %ld calls dispatched\n", serviced - serviced_before,
+	       (serviced - serviced_before) * 60 / building, dispatched);
+	module_stats_print("wait (issue to board)", &stats[0]);
+	module_stats_print("ride (board to alight)", &stats[1]);
+
+	free(producers);
+	return 0;
+}
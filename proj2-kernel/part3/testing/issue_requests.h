@@ -0,0 +1,22 @@
+#ifndef __ISSUE_REQUESTS_H
+#define __ISSUE_REQUESTS_H
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* the batched issue_requests syscall, shared by every test directory's wrappers.h */
+#define __NR_ISSUE_REQUESTS 336
+
+/* one request of an `issue_requests` batch */
+struct elevator_request {
+	int type;
+	int start;
+	int dest;
+};
+
+/* issue `count` requests in one syscall, returns the number of invalid ones */
+int issue_requests(struct elevator_request *requests, unsigned int count) {
+	return syscall(__NR_ISSUE_REQUESTS, requests, count);
+}
+
+#endif